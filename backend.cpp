@@ -0,0 +1,67 @@
+#include "backend.hpp"
+#include "cpubackend.hpp"
+#include "cudabackend.hpp"
+#include "kernels.hpp"
+
+/**
+* Check for a usable cuda device
+*
+* Always false if the toolbox was built without cuda (USE_CUDA=0). Otherwise the check is
+* done at run time, so the same binary can run on nodes without a GPU.
+*
+* @return (bool) true if the cuda backend can be used
+*/
+bool Backend::cudaAvailable()
+{
+#if USE_CUDA
+	return cv::cuda::getCudaEnabledDeviceCount() > 0;
+#else
+	return false;
+#endif
+}
+
+/**
+* Backend factory
+*
+* Select the backend at run time. "auto" picks cuda if the binary was built with it and a
+* device is available, the host backend otherwise. Asking explicitly for "cuda" when it
+* cannot be used is an error.
+*
+* @param _name (string): one of "auto", "cpu", "cuda"
+* @param _debug (bool): print the selected backend
+* @return (cv::Ptr<Backend>) the backend
+*/
+cv::Ptr<Backend> Backend::create(const string& _name, const bool& _debug)
+{
+	cv::Ptr<Backend> be;
+	string name = _name;
+
+	if (name.compare(BACKEND_AUTO) == 0)
+		name = Backend::cudaAvailable() ? BACKEND_CUDA : BACKEND_CPU;
+
+	if (name.compare(BACKEND_CUDA) == 0)
+	{
+		if (!Backend::cudaAvailable())
+		{
+			cerr << "ERR::cuda backend requested but not available (build: USE_CUDA=" << USE_CUDA << "). Quitting..." << endl;
+			exit(-1);
+		}
+#if USE_CUDA
+		be = cv::makePtr<Cudabackend>();
+#endif
+	}
+	else if (name.compare(BACKEND_CPU) == 0)
+	{
+		be = cv::makePtr<Cpubackend>();
+	}
+	else
+	{
+		cerr << "ERR::unknown backend \"" << _name << "\": use auto, cpu or cuda. Quitting..." << endl;
+		exit(-1);
+	}
+
+	if (_debug)
+		cout << "DEBUG::backend: " << be->getName() << " (host kernels: " << Kernels::simdName() << ")" << endl;
+
+	return be;
+}
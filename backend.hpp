@@ -0,0 +1,72 @@
+#ifndef __BACKEND_H__
+#define __BACKEND_H__
+
+#include <opencv2/core.hpp>
+#include <opencv2/opencv_modules.hpp>
+
+#include "generica.hpp"
+
+/**
+* Build-time backend selection
+*
+* USE_CUDA is 1 when OpenCV was built with the cuda modules the toolbox needs.
+* Define USE_CUDA=0 (e.g. -DUSE_CUDA=0) to build a host-only binary on GPU-less machines.
+*/
+#ifndef USE_CUDA
+	#if defined(HAVE_OPENCV_CUDACODEC) && defined(HAVE_OPENCV_CUDAIMGPROC) && defined(HAVE_OPENCV_CUDAFILTERS) \
+		&& defined(HAVE_OPENCV_CUDAARITHM) && defined(HAVE_OPENCV_CUDAOPTFLOW) && defined(HAVE_OPENCV_CUDAWARPING)
+		#define USE_CUDA 1
+	#else
+		#define USE_CUDA 0
+	#endif
+#endif
+
+#define BACKEND_AUTO "auto"
+#define BACKEND_CPU "cpu"
+#define BACKEND_CUDA "cuda"
+
+using namespace std;
+
+class Frame;
+
+/**
+* Compute backend
+*
+* Every operation that touches pixels goes through a backend, so that Frame and Videostream
+* do not depend on where the image lives. The backend owns the video reader and the
+* filters/detectors it needs, and returns host-side results only.
+*/
+class Backend
+{
+public:
+	virtual ~Backend() {}
+
+	// methods::source
+	virtual void open(const string& _filename) = 0;
+	virtual bool nextFrame(Frame& _frame) = 0;
+	virtual bool skipFrame() = 0;		// advance by one frame, no image out
+	virtual bool seek(const int& _frame_n) = 0;
+	virtual bool keyframesOnly() = 0;	// from now on decode keyframes only; false if the reader cannot
+	virtual void load(Frame& _frame, const cv::Mat& _image) = 0;		// host BGR image in place of a decoded one
+	virtual void release() = 0;
+
+	// methods::metrics (blur and motion expect the gray plane and features to be computed)
+	virtual void resize(Frame& _frame, const cv::Size& _size) = 0;		// decoded image (native) -> analysis image
+	virtual void gray(Frame& _frame) = 0;
+	virtual void features(Frame& _frame) = 0;
+	virtual void blur(const Frame& _frame, const cv::Rect& _roi, const int _patch_info[], vector<pair<float, float>>& _blur_level) = 0;
+	virtual cv::Mat hist(const Frame& _frame, const int& ch_number, const int& _bin_number) = 0;
+	virtual float motion(const Frame& _prev, const Frame& _next) = 0;
+
+	// methods::display
+	virtual void openWindow(const string& _window_name, const int& _w, const int& _h) = 0;
+	virtual void show(const string& _window_name, const Frame& _frame) = 0;
+
+	// methods::other
+	virtual string getName() const = 0;
+	virtual int maxWorkers() const = 0;
+	static bool cudaAvailable();
+	static cv::Ptr<Backend> create(const string& _name, const bool& _debug);
+};
+
+#endif
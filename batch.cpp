@@ -0,0 +1,182 @@
+#include "batch.hpp"
+
+Batch::Batch(const Targuments& _args) : pool(Batch::getThreads(_args)), cache(_args.cache_dir)
+{
+	this->segments = _args.segments;
+	this->seconds = 0.0;
+
+	// segments need a reader that can seek
+	cv::Ptr<Backend> be = Backend::create(_args.backend, _args.debug);
+	this->backend_name = be->getName();
+	be->open(_args.video_paths[0].full_filename);
+	if (this->segments != 1 && !be->seek(0))
+	{
+		cout << "WARNING::" << be->getName() << " reader cannot seek: one segment per video" << endl;
+		this->segments = 1;
+	}
+	be->release();
+
+	for (size_t i = 0; i < _args.video_paths.size(); i++)
+	{
+		unique_ptr<Tbatchvideo> video = make_unique<Tbatchvideo>();
+		video->args = _args;
+		video->args.video_path = _args.video_paths[i];
+		video->args.show = false;		// videos are processed concurrently
+		video->segments_left = 0;
+		video->frames = 0;
+		video->seconds = 0.0;
+
+		this->videos.push_back(move(video));
+	}
+}
+
+/**
+* Process all the videos and wait for them
+*/
+void Batch::run()
+{
+	if (this->videos[0]->args.debug)
+		cout << "DEBUG::batch: " << this->videos.size() << " videos, " << this->pool.size() << " threads" << endl;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	for (size_t i = 0; i < this->videos.size(); i++)
+	{
+		Tbatchvideo* video = this->videos[i].get();
+		this->pool.submit([this, video] { this->startVideo(*video); });
+	}
+
+	this->pool.wait();
+	this->seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+* Video job: open the video and its CSV files, submit one job per segment
+*
+* @param _video (Tbatchvideo): the video
+*/
+void Batch::startVideo(Tbatchvideo& _video)
+{
+	_video.start = chrono::steady_clock::now();
+	_video.vs = make_unique<Videostream>(_video.args.video_path);
+	_video.vs->prepare(_video.args);
+	_video.cache_keys = _video.vs->lookupCache(this->cache, _video.args, this->backend_name);
+
+	// every metric restored from the cache: nothing to decode
+	if (!_video.vs->isPending())
+	{
+		this->finishVideo(_video);
+		return;
+	}
+
+	_video.vs->openOutput(_video.args, _video.out);
+	_video.vs->startProgress(_video.args);
+
+	int n = this->segments;
+	if (n <= 0)
+		n = min(this->pool.size(), max(1, _video.vs->getFrameCount() / BATCH_SEGMENT_FRAMES));
+
+	_video.segments = _video.vs->getSegments(n);
+	_video.parts = vector<Toutfiles>(_video.segments.size());
+	_video.segments_left = static_cast<int>(_video.segments.size());
+
+	if (_video.segments.empty())
+	{
+		this->finishVideo(_video);
+		return;
+	}
+
+	for (size_t i = 0; i < _video.segments.size(); i++)
+	{
+		Videostream::openParts(_video.out, _video.parts[i], static_cast<int>(i));
+
+		Tbatchvideo* video = &_video;
+		int index = static_cast<int>(i);
+		this->pool.submit([this, video, index] { this->runSegment(*video, index); });
+	}
+}
+
+/**
+* Segment job; the last segment of the video finishes it
+*
+* @param _video (Tbatchvideo): the video
+* @param _index (int): the segment
+*/
+void Batch::runSegment(Tbatchvideo& _video, const int& _index)
+{
+	_video.frames += _video.vs->segmentLoop(_video.args, _video.segments[_index], _video.parts[_index]);
+
+	if (--_video.segments_left == 0)
+		this->finishVideo(_video);
+}
+
+/**
+* Stitch the CSV files of a video and release it
+*
+* @param _video (Tbatchvideo): the video
+*/
+void Batch::finishVideo(Tbatchvideo& _video)
+{
+	Videostream::stitch(_video.out, _video.parts);
+	Videostream::closeOutput(_video.out);
+	_video.vs->stopProgress();
+	Videostream::storeCache(this->cache, _video.args, _video.cache_keys);
+	if (!_video.segments.empty())
+	{
+		lock_guard<mutex> lk(this->print_lock);		// debug lines of the report
+		_video.vs->savePerf(_video.args, this->backend_name);
+	}
+	_video.parts.clear();
+	_video.vs.reset();
+
+	_video.seconds = chrono::duration<double>(chrono::steady_clock::now() - _video.start).count();
+
+	if (_video.args.debug)
+	{
+		lock_guard<mutex> lk(this->print_lock);
+		cout << "DEBUG::done " << _video.args.video_path.basename << " (" << _video.segments.size() << " segments)" << endl;
+	}
+}
+
+/**
+* Wall time and throughput of each video
+*
+* Videos overlap, so the times do not sum up to the batch time.
+*
+* @param _os (ostream): output stream
+*/
+void Batch::printSummary(ostream& _os) const
+{
+	long tot_frames = 0;
+
+	_os << endl << "DEBUG::summary" << endl;
+	for (size_t i = 0; i < this->videos.size(); i++)
+	{
+		const Tbatchvideo& video = *this->videos[i];
+		double fps = video.seconds > 0.0 ? video.frames / video.seconds : 0.0;
+		tot_frames += video.frames;
+
+		_os << video.args.video_path.basename << ": " << video.frames << " frames, "
+			<< fixed << setprecision(2) << video.seconds << " s, " << fps << " fps" << defaultfloat << endl;
+	}
+
+	double fps = this->seconds > 0.0 ? tot_frames / this->seconds : 0.0;
+	_os << "total: " << this->videos.size() << " videos, " << tot_frames << " frames, "
+		<< fixed << setprecision(2) << this->seconds << " s, " << fps << " fps" << defaultfloat << endl;
+}
+
+/**
+* Threads of the pool
+*
+* "workers" in settings, or all the cores if 0: every job decodes and analyzes serially.
+*
+* @param _args (Targuments): parsed settings
+* @return (int) number of threads, >= 1
+*/
+int Batch::getThreads(const Targuments& _args)
+{
+	if (_args.workers > 0)
+		return _args.workers;
+
+	return max(1, static_cast<int>(thread::hardware_concurrency()));
+}
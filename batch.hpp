@@ -0,0 +1,66 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#include "videostream.hpp"
+#include "scheduler.hpp"
+
+#define BATCH_SEGMENT_FRAMES 9000	// auto segments: one every 9000 frames (5 min at 30 fps)
+
+using namespace std;
+
+// a video of the batch, shared by its segment jobs
+typedef struct
+{
+	Targuments args;
+	unique_ptr<Videostream> vs;
+	Toutfiles out;
+	vector<Tsegment> segments;
+	vector<Toutfiles> parts;
+	map<string, string> cache_keys;		// metrics to store in the result cache
+	atomic<int> segments_left;
+	atomic<long> frames;
+	chrono::steady_clock::time_point start;
+	double seconds;
+}Tbatchvideo;
+
+/**
+* Batch of videos
+*
+* All the videos of the settings are processed by one work-stealing pool (Scheduler). Every
+* video is a job that splits it in segments and submits one job per segment; the last segment
+* to finish stitches the CSV files of its video. Idle threads steal segments of the long
+* videos, so that the pool stays busy until the end of the batch.
+*/
+class Batch
+{
+private:
+	Scheduler pool;
+	Resultcache cache;
+	string backend_name;
+	vector<unique_ptr<Tbatchvideo>> videos;
+	int segments;			// per video, 0 = auto
+	double seconds;			// wall time of the batch
+	mutex print_lock;
+
+	void startVideo(Tbatchvideo& _video);
+	void runSegment(Tbatchvideo& _video, const int& _index);
+	void finishVideo(Tbatchvideo& _video);
+
+public:
+	// Constructors
+	Batch(const Targuments& _args);
+
+	// methods
+	void run();
+	void printSummary(ostream& _os) const;
+	static int getThreads(const Targuments& _args);
+};
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef __BOUNDEDQUEUE_H__
+#define __BOUNDEDQUEUE_H__
+
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+/**
+* Bounded lock-free multi-producer multi-consumer queue
+*
+* Each cell carries a sequence number that tells producers and consumers whether it is free
+* or full for their lap around the array, so push and pop need a single compare-and-swap
+* and no lock. The blocking variants spin, then yield, then sleep briefly: stages of the
+* pipeline wait on each other for milliseconds at most. close() wakes up the consumers
+* once the queue is drained. Template methods must be in the header.
+*
+* @see [D. Vyukov, bounded MPMC queue](https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue)
+*/
+template <typename T>
+class Boundedqueue
+{
+private:
+	typedef struct
+	{
+		atomic<size_t> seq;
+		T data;
+	}Tcell;
+
+	vector<Tcell> cells;
+	size_t mask;
+	alignas(64) atomic<size_t> enqueue_pos;
+	alignas(64) atomic<size_t> dequeue_pos;
+	alignas(64) atomic<bool> closed;
+
+	/// back-off of the blocking methods
+	static void wait(int& _spins)
+	{
+		if (_spins < 64)
+			_spins += 1;
+		else if (_spins < 128)
+		{
+			_spins += 1;
+			this_thread::yield();
+		}
+		else
+			this_thread::sleep_for(chrono::microseconds(50));
+	}
+
+public:
+	// Constructors
+	Boundedqueue(const size_t& _capacity) : cells(Boundedqueue::roundUp(_capacity))
+	{
+		this->mask = this->cells.size() - 1;
+		for (size_t i = 0; i < this->cells.size(); i++)
+			this->cells[i].seq.store(i, memory_order_relaxed);
+
+		this->enqueue_pos.store(0, memory_order_relaxed);
+		this->dequeue_pos.store(0, memory_order_relaxed);
+		this->closed.store(false, memory_order_relaxed);
+	}
+
+	Boundedqueue(const Boundedqueue&) = delete;
+	Boundedqueue& operator=(const Boundedqueue&) = delete;
+
+	/// non-blocking push: false if the queue is full
+	bool tryPush(const T& _elem)
+	{
+		size_t pos = this->enqueue_pos.load(memory_order_relaxed);
+
+		while (true)
+		{
+			Tcell& cell = this->cells[pos & this->mask];
+			size_t seq = cell.seq.load(memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+			if (diff == 0)
+			{
+				if (this->enqueue_pos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+				{
+					cell.data = _elem;
+					cell.seq.store(pos + 1, memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = this->enqueue_pos.load(memory_order_relaxed);
+		}
+	}
+
+	/// non-blocking pop: false if the queue is empty
+	bool tryPop(T& _elem)
+	{
+		size_t pos = this->dequeue_pos.load(memory_order_relaxed);
+
+		while (true)
+		{
+			Tcell& cell = this->cells[pos & this->mask];
+			size_t seq = cell.seq.load(memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+
+			if (diff == 0)
+			{
+				if (this->dequeue_pos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+				{
+					_elem = cell.data;
+					cell.seq.store(pos + this->mask + 1, memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = this->dequeue_pos.load(memory_order_relaxed);
+		}
+	}
+
+	/// blocking push
+	void push(const T& _elem)
+	{
+		int spins = 0;
+		while (!tryPush(_elem))
+			Boundedqueue::wait(spins);
+	}
+
+	/**
+	* Blocking pop
+	*
+	* @return (bool) false if the queue has been closed and is empty
+	*/
+	bool pop(T& _elem)
+	{
+		int spins = 0;
+		while (!tryPop(_elem))
+		{
+			if (this->closed.load(memory_order_acquire))
+				return tryPop(_elem);		// a push may have landed right before close()
+
+			Boundedqueue::wait(spins);
+		}
+
+		return true;
+	}
+
+	/// no more pushes: pop() returns false once the queue is drained
+	void close()
+	{
+		this->closed.store(true, memory_order_release);
+	}
+
+	/// approximate number of elements (for monitoring)
+	size_t size() const
+	{
+		size_t e = this->enqueue_pos.load(memory_order_relaxed), d = this->dequeue_pos.load(memory_order_relaxed);
+		return e > d ? e - d : 0;
+	}
+
+	size_t capacity() const
+	{
+		return this->cells.size();
+	}
+
+	/// capacity rounded to a power of two (>= 2), so that positions wrap with a mask
+	static size_t roundUp(const size_t& _n)
+	{
+		size_t c = 2;
+		while (c < _n)
+			c <<= 1;
+
+		return c;
+	}
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include "builtinmetrics.hpp"
+
+/* BLUR */
+string Blurmetric::getName() const
+{
+	return "blur";
+}
+
+int Blurmetric::getProducts() const
+{
+	return PRODUCT_GRAY;
+}
+
+/// two columns for each patch (blur_yx, var_yx), row-major
+vector<string> Blurmetric::getColumns() const
+{
+	vector<string> columns;
+
+	for (int y = 0; y < this->setup.patch_info[1]; y++)
+	{
+		for (int x = 0; x < this->setup.patch_info[0]; x++)
+		{
+			columns.push_back("blur_" + to_string(y) + to_string(x));
+			columns.push_back("var_" + to_string(y) + to_string(x));
+		}
+	}
+
+	return columns;
+}
+
+const int* Blurmetric::getPatchInfo() const
+{
+	return this->setup.patch_info;
+}
+
+json Blurmetric::getParams() const
+{
+	json params = json::object();
+	params["blur_roi"] = { this->setup.roi.x, this->setup.roi.y, this->setup.roi.width, this->setup.roi.height };
+	params["patch_info"] = { this->setup.patch_info[0], this->setup.patch_info[1], this->setup.patch_info[2], this->setup.patch_info[3] };
+
+	return params;
+}
+
+/**
+* Blur of the frame
+*
+* @param _ctx (Framecontext): the frame, gray plane at the blur level
+* @param _row (vector<float>): output, (blur variance, pixel variance) of each patch
+*/
+void Blurmetric::compute(Framecontext& _ctx, vector<float>& _row) const
+{
+	Frame& frame = _ctx.getFrame();
+	frame.computeBlur(_ctx.getBackend(), _ctx.gray(this->setup.level), this->setup.roi, this->setup.patch_info);
+
+	vector<pair<float, float>> bv = frame.getBlurLevel();
+	_row.clear();
+	for (size_t i = 0; i < bv.size(); i++)
+	{
+		_row.push_back(bv[i].first);
+		_row.push_back(bv[i].second);
+	}
+}
+
+/* EXPOSURE */
+string Exposuremetric::getName() const
+{
+	return "exposure";
+}
+
+int Exposuremetric::getProducts() const
+{
+	return PRODUCT_VHIST;
+}
+
+json Exposuremetric::getParams() const
+{
+	return json{ { "bins", MIN_BIN_NUMBER } };
+}
+
+void Exposuremetric::compute(Framecontext& _ctx, vector<float>& _row) const
+{
+	Frame& frame = _ctx.getFrame();
+	frame.computeExposure(_ctx.hist(this->setup.level, MIN_BIN_NUMBER), this->setup.size.area());
+	_row.assign(1, frame.getExposureLevel());
+}
+
+/* ENTROPY */
+string Entropymetric::getName() const
+{
+	return "entropy";
+}
+
+int Entropymetric::getProducts() const
+{
+	return PRODUCT_VHIST;
+}
+
+json Entropymetric::getParams() const
+{
+	return json{ { "bins", MAX_BIN_NUMBER } };
+}
+
+void Entropymetric::compute(Framecontext& _ctx, vector<float>& _row) const
+{
+	Frame& frame = _ctx.getFrame();
+	frame.computeEntropy(_ctx.hist(this->setup.level, MAX_BIN_NUMBER), this->setup.size.area());
+	_row.assign(1, frame.getEntropyLevel());
+}
+
+/* MOTION */
+string Motionmetric::getName() const
+{
+	return "motion";
+}
+
+/// features are built on every frame: the next one reads them on its previous frame
+int Motionmetric::getProducts() const
+{
+	return PRODUCT_GRAY | PRODUCT_FEATURES | PRODUCT_PREVIOUS;
+}
+
+int Motionmetric::getHistory() const
+{
+	return MOTION_HISTORY;
+}
+
+/**
+* Motion between the previous frame and this one, in order
+*
+* @param _ctx (Framecontext): the frame, last in its history
+* @param _row (vector<float>): output, amount of motion (0 for the first frame)
+*/
+void Motionmetric::compute(Framecontext& _ctx, vector<float>& _row) const
+{
+	Frame& frame = _ctx.getFrame();
+	frame.computeMotion(_ctx.getBackend(), _ctx.previous(this->setup.level), _ctx.gray(this->setup.level));
+	_row.assign(1, frame.getMotionLevel());
+}
@@ -0,0 +1,58 @@
+#ifndef __BUILTINMETRICS_H__
+#define __BUILTINMETRICS_H__
+
+#include "metric.hpp"
+
+using namespace std;
+
+/**
+* Blur: variance of the Laplacian and of the pixels of each patch of the ROI (Frame::computeBlur)
+*/
+class Blurmetric : public Metric
+{
+public:
+	string getName() const override;
+	int getProducts() const override;
+	vector<string> getColumns() const override;
+	const int* getPatchInfo() const override;
+	json getParams() const override;
+	void compute(Framecontext& _ctx, vector<float>& _row) const override;
+};
+
+/**
+* Exposure: balance of the MIN_BIN_NUMBER bins of the V histogram (Frame::computeExposure)
+*/
+class Exposuremetric : public Metric
+{
+public:
+	string getName() const override;
+	int getProducts() const override;
+	json getParams() const override;
+	void compute(Framecontext& _ctx, vector<float>& _row) const override;
+};
+
+/**
+* Entropy: Shannon entropy of the full V histogram (Frame::computeEntropy)
+*/
+class Entropymetric : public Metric
+{
+public:
+	string getName() const override;
+	int getProducts() const override;
+	json getParams() const override;
+	void compute(Framecontext& _ctx, vector<float>& _row) const override;
+};
+
+/**
+* Motion: sparse optical flow of the features of the previous frame (Frame::computeMotion)
+*/
+class Motionmetric : public Metric
+{
+public:
+	string getName() const override;
+	int getProducts() const override;
+	int getHistory() const override;
+	void compute(Framecontext& _ctx, vector<float>& _row) const override;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "checkpoint.hpp"
+
+Checkpoint::Checkpoint()
+{
+	this->frames_since = 0;
+	this->last_save = chrono::steady_clock::now();
+}
+
+/**
+* Set the checkpoint file
+*
+* @param _meta_dir (string): the <name>_meta directory of the video
+*/
+void Checkpoint::open(const string& _meta_dir)
+{
+	this->path = (filesystem::u8path(_meta_dir) / CHECKPOINT_FILE).string();
+	this->state = json::object();
+	this->frames_since = 0;
+	this->last_save = chrono::steady_clock::now();
+}
+
+/**
+* Read the checkpoint of a previous run
+*
+* @param _fingerprint (json): video and settings of this run
+* @return (bool) true if the previous run stopped before the end with the same fingerprint
+*/
+bool Checkpoint::load(const json& _fingerprint)
+{
+	ifstream file(filesystem::u8path(this->path));
+	if (!file.is_open())
+		return false;
+
+	try
+	{
+		file >> this->state;
+	}
+	catch (const exception& msg)
+	{
+		cout << "WARNING::unreadable checkpoint " << this->path << ": " << msg.what() << endl;
+		this->state = json::object();
+		return false;
+	}
+
+	return this->state.value("fingerprint", json()) == _fingerprint
+		&& !this->state.value("done", true)
+		&& this->state.value("next_frame", 0) > 0;
+}
+
+/**
+* Call once per written frame
+*
+* @return (bool) true if a checkpoint should be saved now
+*/
+bool Checkpoint::due()
+{
+	this->frames_since += 1;
+
+	return this->frames_since >= CHECKPOINT_FRAMES
+		|| chrono::steady_clock::now() - this->last_save >= chrono::seconds(CHECKPOINT_SEC);
+}
+
+/**
+* Save the checkpoint (the outputs must be flushed)
+*
+* @param _fingerprint (json): video and settings of this run
+* @param _next_frame (int): first frame not written yet
+* @param _outputs (json): size of the output files, see Videostream::getOutputSizes
+* @param _done (bool): true at the end of the video
+*/
+void Checkpoint::save(const json& _fingerprint, const int& _next_frame, const json& _outputs, const bool& _done)
+{
+	this->state = json::object();
+	this->state["fingerprint"] = _fingerprint;
+	this->state["next_frame"] = _next_frame;
+	this->state["seed_frame"] = _next_frame - 1;		// motion: its gray plane and features are rebuilt on resume
+	this->state["outputs"] = _outputs;
+	this->state["done"] = _done;
+
+	string tmp_path = this->path + ".tmp";
+	{
+		ofstream tmp(filesystem::u8path(tmp_path), ios_base::trunc);
+		tmp << this->state.dump(1, '\t') << endl;
+	}
+	filesystem::rename(filesystem::u8path(tmp_path), filesystem::u8path(this->path));
+
+	this->frames_since = 0;
+	this->last_save = chrono::steady_clock::now();
+}
+
+int Checkpoint::getNextFrame() const
+{
+	return this->state.value("next_frame", 0);
+}
+
+int Checkpoint::getSeedFrame() const
+{
+	return this->state.value("seed_frame", -1);
+}
+
+json Checkpoint::getOutputs() const
+{
+	return this->state.value("outputs", json::object());
+}
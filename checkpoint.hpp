@@ -0,0 +1,52 @@
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <filesystem>
+
+#include "json.hpp"
+
+#define CHECKPOINT_FILE "checkpoint.json"
+#define CHECKPOINT_FRAMES 9000		// at most one checkpoint every 9000 frames...
+#define CHECKPOINT_SEC 60			// ...or every 60 seconds, whichever comes first
+
+using namespace std;
+using json = nlohmann::json;
+
+/**
+* Progress of a video, to resume an interrupted run
+*
+* The checkpoint holds the first frame not yet written, the size of every output file at that
+* frame and the frame that seeds the temporal metrics (motion). It is only written after the
+* outputs are flushed, and atomically (temporary file + rename), so the outputs always hold at
+* least what the checkpoint says. A fingerprint of the video and of the settings that shape the
+* outputs prevents resuming with different settings.
+*/
+class Checkpoint
+{
+private:
+	string path;
+	json state;
+	int frames_since;		// frames since the last save
+	chrono::steady_clock::time_point last_save;
+
+public:
+	// Constructors
+	Checkpoint();
+
+	// methods
+	void open(const string& _meta_dir);
+	bool load(const json& _fingerprint);
+	bool due();
+	void save(const json& _fingerprint, const int& _next_frame, const json& _outputs, const bool& _done);
+
+	// methods::getter
+	int getNextFrame() const;
+	int getSeedFrame() const;
+	json getOutputs() const;
+};
+
+#endif
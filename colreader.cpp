@@ -0,0 +1,215 @@
+#include "colreader.hpp"
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+/**
+* Open a <feature>.cols directory
+*
+* @param _dir (string): the directory
+* @throws runtime_error if the header is missing, not a Colwriter header or without columns,
+*         or if a column file cannot be mapped
+*/
+Colreader::Colreader(const string& _dir)
+{
+	filesystem::path dir = filesystem::u8path(_dir);
+	ifstream header_file(dir / COL_HEADER);
+
+	if (!header_file.is_open())
+		throw runtime_error("missing " + (dir / COL_HEADER).string());
+
+	header_file >> this->header;
+	if (this->header.value("format", "") != COL_FORMAT || this->header.value("version", 0) > COL_VERSION)
+		throw runtime_error((dir / COL_HEADER).string() + " is not a " + COL_FORMAT + " v" + to_string(COL_VERSION) + " header");
+
+	const json& header_columns = this->header.at("columns");
+	if (header_columns.empty())
+		throw runtime_error((dir / COL_HEADER).string() + " has no columns (frame_n is required)");
+
+	this->columns = vector<Tcolumn>(header_columns.size());		// data nullptr: unmap skips them
+	this->rows = SIZE_MAX;
+
+	try
+	{
+		for (size_t i = 0; i < header_columns.size(); i++)
+		{
+			this->columns[i].name = header_columns[i].at("name").get<string>();
+			this->map(this->columns[i], dir / header_columns[i].at("file").get<string>());
+			this->rows = min(this->rows, this->columns[i].bytes / sizeof(uint32_t));
+		}
+	}
+	catch (...)
+	{
+		// no destructor for a half-built reader: release the columns mapped so far
+		for (size_t i = 0; i < this->columns.size(); i++)
+			this->unmap(this->columns[i]);
+		throw;
+	}
+}
+
+Colreader::~Colreader()
+{
+	for (size_t i = 0; i < this->columns.size(); i++)
+		this->unmap(this->columns[i]);
+}
+
+size_t Colreader::getRows() const
+{
+	return this->rows;
+}
+
+/// column names, frame_n first
+vector<string> Colreader::getColumns() const
+{
+	vector<string> names;
+	for (size_t i = 0; i < this->columns.size(); i++)
+		names.push_back(this->columns[i].name);
+
+	return names;
+}
+
+/// frame numbers, getRows() elements
+const int32_t* Colreader::getFrames() const
+{
+	return reinterpret_cast<const int32_t*>(this->columns[0].data);
+}
+
+/**
+* Values of a column
+*
+* @param _name (string): column name, as in the CSV header
+* @return (float*) getRows() elements, nullptr if there is no such column
+*/
+const float* Colreader::getColumn(const string& _name) const
+{
+	for (size_t i = 1; i < this->columns.size(); i++)
+		if (this->columns[i].name.compare(_name) == 0)
+			return reinterpret_cast<const float*>(this->columns[i].data);
+
+	return nullptr;
+}
+
+const json& Colreader::getHeader() const
+{
+	return this->header;
+}
+
+/**
+* Write the columns as the CSV file the toolbox would have written
+*
+* @param _os (ostream): output stream
+*/
+void Colreader::toCSV(ostream& _os) const
+{
+	string line;
+	char tmp[32];
+
+	for (size_t i = 0; i < this->columns.size(); i++)
+		line += (i == 0 ? "" : ",") + this->columns[i].name;
+	_os << line << "\n";
+
+	const int32_t* frames = this->getFrames();
+	for (size_t r = 0; r < this->rows; r++)
+	{
+		line.clear();
+		to_chars_result res = to_chars(tmp, tmp + sizeof(tmp), frames[r]);
+		line.append(tmp, res.ptr);
+
+		for (size_t c = 1; c < this->columns.size(); c++)
+		{
+			const float* values = reinterpret_cast<const float*>(this->columns[c].data);
+			res = to_chars(tmp, tmp + sizeof(tmp), values[r], chars_format::general, 6);		// as Csvwriter
+			line.push_back(',');
+			line.append(tmp, res.ptr);
+		}
+
+		_os << line << "\n";
+	}
+}
+
+/**
+* Map a column file (or load and byte-swap it on big-endian hosts)
+*
+* @param _col (Tcolumn): the column
+* @param _path (filesystem::path): its file
+* @throws runtime_error if the file cannot be opened
+*/
+void Colreader::map(Tcolumn& _col, const filesystem::path& _path)
+{
+	_col.data = nullptr;
+	_col.handle = nullptr;
+	_col.bytes = static_cast<size_t>(filesystem::file_size(_path));
+
+	if (!Colreader::hostIsLittleEndian())
+	{
+		ifstream src(_path, ios_base::binary);
+		_col.copy = vector<uint8_t>(_col.bytes);
+		src.read(reinterpret_cast<char*>(_col.copy.data()), _col.bytes);
+
+		for (size_t i = 0; i + 3 < _col.bytes; i += 4)
+		{
+			swap(_col.copy[i], _col.copy[i + 3]);
+			swap(_col.copy[i + 1], _col.copy[i + 2]);
+		}
+
+		_col.data = _col.copy.data();
+		return;
+	}
+
+	if (_col.bytes == 0)
+		return;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileW(_path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		throw runtime_error("cannot open " + _path.string());
+
+	HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (mapping == NULL)
+		throw runtime_error("cannot map " + _path.string());
+
+	_col.data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	_col.handle = mapping;
+#else
+	int fd = ::open(_path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw runtime_error("cannot open " + _path.string());
+
+	void* addr = mmap(nullptr, _col.bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (addr == MAP_FAILED)
+		throw runtime_error("cannot map " + _path.string());
+
+	_col.data = static_cast<const uint8_t*>(addr);
+#endif
+}
+
+void Colreader::unmap(Tcolumn& _col)
+{
+	if (_col.data == nullptr || !_col.copy.empty())
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(_col.data);
+	CloseHandle(static_cast<HANDLE>(_col.handle));
+#else
+	munmap(const_cast<uint8_t*>(_col.data), _col.bytes);
+#endif
+	_col.data = nullptr;
+}
+
+bool Colreader::hostIsLittleEndian()
+{
+	const uint32_t one = 1;
+	uint8_t first;
+	memcpy(&first, &one, 1);
+
+	return first == 1;
+}
@@ -0,0 +1,67 @@
+#ifndef __COLREADER_H__
+#define __COLREADER_H__
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <charconv>
+#include <filesystem>
+#include <stdexcept>
+
+#include "json.hpp"
+#include "colwriter.hpp"
+
+using namespace std;
+using json = nlohmann::json;
+
+/**
+* Reader of the binary columns written by Colwriter
+*
+* Column files are memory-mapped: getFrames() and getColumn() point straight into the files,
+* nothing is parsed or copied. On big-endian hosts the columns are loaded and byte-swapped.
+* The number of rows is the one of the shortest column file, so that a directory whose
+* writer did not close cleanly is still readable up to its last complete row.
+*/
+class Colreader
+{
+private:
+	typedef struct
+	{
+		string name;
+		const uint8_t* data;		// mapping or owned copy
+		size_t bytes;
+		vector<uint8_t> copy;		// big-endian hosts only
+		void* handle;				// platform mapping handle
+	}Tcolumn;
+
+	json header;
+	vector<Tcolumn> columns;
+	size_t rows;
+
+	void map(Tcolumn& _col, const filesystem::path& _path);
+	void unmap(Tcolumn& _col);
+	static bool hostIsLittleEndian();
+
+public:
+	// Constructors
+	Colreader(const string& _dir);
+	~Colreader();
+
+	Colreader(const Colreader&) = delete;
+	Colreader& operator=(const Colreader&) = delete;
+
+	// methods::getter
+	size_t getRows() const;
+	vector<string> getColumns() const;
+	const int32_t* getFrames() const;
+	const float* getColumn(const string& _name) const;
+	const json& getHeader() const;
+
+	// methods::other
+	void toCSV(ostream& _os) const;
+};
+
+#endif
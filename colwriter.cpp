@@ -0,0 +1,250 @@
+#include "colwriter.hpp"
+
+Colwriter::Colwriter()
+{
+	this->rows = 0;
+}
+
+Colwriter::~Colwriter()
+{
+	this->close();
+}
+
+/**
+* Create the directory and the column files (truncated)
+*
+* @param _dir (string): <feature>.cols directory
+* @param _feature_name (string): the feature
+* @param _columns (vector<string>): value columns, see Metric::getColumns
+* @param _patch_info (int*): nx, ny, w, h; nullptr if the feature has no patches
+* @param _scale (double): analysis scale (analysis height / video height)
+* @param _level (int): pyramid level of the feature
+*/
+void Colwriter::open(const string& _dir, const string& _feature_name, const vector<string>& _columns, const int _patch_info[], const double& _scale, const int& _level)
+{
+	this->close();
+
+	// delete first, the old files may be links to the result cache
+	filesystem::remove_all(filesystem::u8path(_dir));
+	filesystem::create_directories(filesystem::u8path(_dir));
+	this->dir = _dir;
+	this->rows = 0;
+
+	this->header = json::object();
+	this->header["format"] = COL_FORMAT;
+	this->header["version"] = COL_VERSION;
+	this->header["endianness"] = "little";
+	this->header["feature"] = _feature_name;
+	this->header["rows"] = 0;
+	if (_patch_info != nullptr)
+		this->header["patch_grid"] = { _patch_info[0], _patch_info[1] };
+	if (_scale != 1.0)
+		this->header["scale"] = _scale;
+	if (_level != 0)
+		this->header["level"] = _level;
+
+	vector<string> names = { COL_FRAME };
+	names.insert(names.end(), _columns.begin(), _columns.end());
+
+	json columns = json::array();
+	this->files = vector<ofstream>(names.size());
+	this->buffers = vector<vector<uint8_t>>(names.size());
+
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		string file = names[i] + ".bin";
+		columns.push_back({ { "name", names[i] }, { "type", i == 0 ? "int32" : "float32" }, { "file", file } });
+
+		this->files[i].open(filesystem::u8path(_dir) / file, ios_base::binary | ios_base::trunc);
+		if (!this->files[i].is_open())
+		{
+			cerr << "ERR::cannot open " << _dir << "/" << file << ". Quitting..." << endl;
+			exit(-1);
+		}
+
+		this->buffers[i].reserve(COL_BUFFER_ROWS * sizeof(uint32_t));
+	}
+
+	this->header["columns"] = columns;
+	this->writeHeader();
+}
+
+/**
+* Create a directory with the same columns as another writer (segment parts)
+*
+* @param _dir (string): the new directory
+* @param _model (Colwriter): an open writer
+*/
+void Colwriter::openLike(const string& _dir, const Colwriter& _model)
+{
+	vector<string> columns;
+	const json& model_columns = _model.header.at("columns");
+	for (size_t i = 1; i < model_columns.size(); i++)
+		columns.push_back(model_columns[i]["name"].get<string>());
+
+	int patch_info[2] = { 0, 0 };
+	bool patches = _model.header.contains("patch_grid");
+	if (patches)
+	{
+		patch_info[0] = _model.header["patch_grid"][0].get<int>();
+		patch_info[1] = _model.header["patch_grid"][1].get<int>();
+	}
+
+	this->open(_dir, _model.header.at("feature").get<string>(), columns, patches ? patch_info : nullptr, _model.header.value("scale", 1.0), _model.header.value("level", 0));
+}
+
+/**
+* Append a row
+*
+* @param _count (int): frame number
+* @param _values (float*): one value for each column
+* @param _n (int): number of values
+*/
+void Colwriter::putRow(const int& _count, const float _values[], const int& _n)
+{
+	uint32_t bits;
+
+	memcpy(&bits, &_count, sizeof(bits));
+	Colwriter::putLE(this->buffers[0], bits);
+
+	for (int i = 0; i < _n && i + 1 < static_cast<int>(this->buffers.size()); i++)
+	{
+		memcpy(&bits, &_values[i], sizeof(bits));
+		Colwriter::putLE(this->buffers[i + 1], bits);
+	}
+
+	this->rows += 1;
+	if (this->buffers[0].size() >= COL_BUFFER_ROWS * sizeof(uint32_t))
+		this->flush();
+}
+
+/// write the buffered rows and update the header
+void Colwriter::flush()
+{
+	if (!this->isOpen())
+		return;
+
+	for (size_t i = 0; i < this->files.size(); i++)
+	{
+		this->files[i].write(reinterpret_cast<const char*>(this->buffers[i].data()), this->buffers[i].size());
+		this->files[i].flush();
+		this->buffers[i].clear();
+	}
+
+	this->writeHeader();
+}
+
+void Colwriter::close()
+{
+	if (!this->isOpen())
+		return;
+
+	this->flush();
+	for (size_t i = 0; i < this->files.size(); i++)
+		this->files[i].close();
+
+	this->files.clear();
+	this->buffers.clear();
+	this->dir.clear();
+}
+
+/**
+* Append the columns of another directory with the same columns (segment parts)
+*
+* @param _dir (string): the <feature>.cols directory to copy at the end of this one
+*/
+void Colwriter::appendDir(const string& _dir)
+{
+	this->flush();
+
+	const json& columns = this->header["columns"];
+	size_t added = 0;
+
+	for (size_t i = 0; i < this->files.size(); i++)
+	{
+		filesystem::path src_path = filesystem::u8path(_dir) / columns[i]["file"].get<string>();
+		ifstream src(src_path, ios_base::binary);
+
+		if (src.peek() != ifstream::traits_type::eof())
+			this->files[i] << src.rdbuf();
+
+		if (i == 0)
+			added = static_cast<size_t>(filesystem::file_size(src_path) / sizeof(uint32_t));
+	}
+
+	this->rows += added;
+	this->writeHeader();
+}
+
+bool Colwriter::isOpen() const
+{
+	return !this->dir.empty();
+}
+
+size_t Colwriter::getRows() const
+{
+	return this->rows;
+}
+
+/**
+* Reopen an existing directory, truncated to its first _rows rows (resume from checkpoint)
+*
+* @param _dir (string): <feature>.cols directory
+* @param _rows (size_t): rows to keep
+* @return (bool) false if the directory is missing, or shorter than _rows
+*/
+bool Colwriter::resume(const string& _dir, const size_t& _rows)
+{
+	this->close();
+
+	ifstream header_file(filesystem::u8path(_dir) / COL_HEADER);
+	if (!header_file.is_open())
+		return false;
+
+	json old_header;
+	header_file >> old_header;
+	const json& columns = old_header.at("columns");
+
+	for (size_t i = 0; i < columns.size(); i++)
+	{
+		filesystem::path col_path = filesystem::u8path(_dir) / columns[i]["file"].get<string>();
+		if (!filesystem::exists(col_path) || filesystem::file_size(col_path) < _rows * sizeof(uint32_t))
+			return false;
+	}
+
+	this->header = old_header;
+	this->dir = _dir;
+	this->rows = _rows;
+	this->files = vector<ofstream>(columns.size());
+	this->buffers = vector<vector<uint8_t>>(columns.size());
+
+	for (size_t i = 0; i < columns.size(); i++)
+	{
+		filesystem::path col_path = filesystem::u8path(_dir) / columns[i]["file"].get<string>();
+		filesystem::resize_file(col_path, _rows * sizeof(uint32_t));
+
+		this->files[i].open(col_path, ios_base::binary | ios_base::app);
+		this->buffers[i].reserve(COL_BUFFER_ROWS * sizeof(uint32_t));
+	}
+
+	this->writeHeader();
+	return true;
+}
+
+/// header.json, rewritten as rows are written
+void Colwriter::writeHeader()
+{
+	this->header["rows"] = this->rows;
+
+	ofstream out(filesystem::u8path(this->dir) / COL_HEADER, ios_base::trunc);
+	out << this->header.dump(1, '\t') << endl;
+}
+
+/// append 4 bytes, least significant first (whatever the host byte order)
+void Colwriter::putLE(vector<uint8_t>& _buf, const uint32_t& _bits)
+{
+	_buf.push_back(static_cast<uint8_t>(_bits));
+	_buf.push_back(static_cast<uint8_t>(_bits >> 8));
+	_buf.push_back(static_cast<uint8_t>(_bits >> 16));
+	_buf.push_back(static_cast<uint8_t>(_bits >> 24));
+}
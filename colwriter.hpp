@@ -0,0 +1,66 @@
+#ifndef __COLWRITER_H__
+#define __COLWRITER_H__
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+
+#include "json.hpp"
+
+#define COL_FORMAT "vat-columns"
+#define COL_VERSION 1
+#define COL_HEADER "header.json"
+#define COL_FRAME "frame_n"
+#define COL_BUFFER_ROWS 65536		// rows buffered in memory before writing
+
+using namespace std;
+using json = nlohmann::json;
+
+/**
+* Binary columnar writer
+*
+* One directory per feature (<feature>.cols) with one file per column (<column>.bin):
+* frame_n is int32, the values are float32, all little-endian, one element per frame, no
+* padding. A column file is a plain array, so it can be memory-mapped and used as-is.
+* header.json describes the columns, the patch grid, the analysis scale (if not 1), the
+* pyramid level (if not 0) and the number of rows.
+*
+* Columns are buffered in memory and written every COL_BUFFER_ROWS rows.
+*/
+class Colwriter
+{
+private:
+	string dir;
+	json header;
+	vector<ofstream> files;			// frame_n first, then the values
+	vector<vector<uint8_t>> buffers;
+	size_t rows;					// rows written, buffered included
+
+	void writeHeader();
+	static void putLE(vector<uint8_t>& _buf, const uint32_t& _bits);
+
+public:
+	// Constructors
+	Colwriter();
+	~Colwriter();
+
+	Colwriter(const Colwriter&) = delete;
+	Colwriter& operator=(const Colwriter&) = delete;
+
+	// methods
+	void open(const string& _dir, const string& _feature_name, const vector<string>& _columns, const int _patch_info[], const double& _scale=1.0, const int& _level=0);
+	void openLike(const string& _dir, const Colwriter& _model);
+	bool resume(const string& _dir, const size_t& _rows);
+	void putRow(const int& _count, const float _values[], const int& _n);
+	void flush();
+	void close();
+	void appendDir(const string& _dir);
+	bool isOpen() const;
+	size_t getRows() const;
+};
+
+#endif
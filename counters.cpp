@@ -0,0 +1,33 @@
+#include "counters.hpp"
+
+atomic<uint64_t> Counters::frames(0);
+atomic<uint64_t> Counters::gray_conversions(0);
+atomic<uint64_t> Counters::buffer_allocs(0);
+atomic<uint64_t> Counters::bytes_copied(0);
+
+void Counters::reset()
+{
+	Counters::frames = 0;
+	Counters::gray_conversions = 0;
+	Counters::buffer_allocs = 0;
+	Counters::bytes_copied = 0;
+}
+
+/**
+* Print the counters, normalized per analyzed frame
+*
+* @param _os (ostream): output stream
+*/
+void Counters::print(ostream& _os)
+{
+	uint64_t n = Counters::frames.load();
+	double per_frame = n > 0 ? 1.0 / static_cast<double>(n) : 0.0;
+
+	_os << "DEBUG::counters: frames = " << n << endl
+		<< "DEBUG::counters: gray conversions = " << Counters::gray_conversions.load()
+		<< " (" << Counters::gray_conversions.load() * per_frame << " per frame)" << endl
+		<< "DEBUG::counters: buffer allocations = " << Counters::buffer_allocs.load()
+		<< " (" << Counters::buffer_allocs.load() * per_frame << " per frame)" << endl
+		<< "DEBUG::counters: bytes copied = " << Counters::bytes_copied.load()
+		<< " (" << Counters::bytes_copied.load() * per_frame << " per frame)" << endl;
+}
@@ -0,0 +1,30 @@
+#ifndef __COUNTERS_H__
+#define __COUNTERS_H__
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+
+using namespace std;
+
+/**
+* Instrumentation counters
+*
+* Process-wide event counters, cheap enough to stay enabled (one relaxed atomic increment per event:
+* they count, they do not order anything).
+* They are printed at the end of a run in debug mode.
+*/
+class Counters
+{
+public:
+	static atomic<uint64_t> frames;				// frames analyzed
+	static atomic<uint64_t> gray_conversions;	// BGR(A) -> gray conversions
+	static atomic<uint64_t> buffer_allocs;		// frame-sized buffers (re)allocated: decoded images, gray planes
+	static atomic<uint64_t> bytes_copied;		// deep copies by the toolbox: loaded images, uploads, full histograms (decoder output excluded)
+
+	// methods
+	static void reset();
+	static void print(ostream& _os);
+};
+
+#endif
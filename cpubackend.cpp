@@ -0,0 +1,394 @@
+#include "cpubackend.hpp"
+
+Cpubackend::Cpubackend()
+{
+	this->cap = cv::VideoCapture();
+}
+
+/**
+* Open the video with the host decoder
+*
+* Synthetic videos (.synth) are generated by Synthsource instead.
+*
+* @param _filename (string): full path to the video
+*/
+void Cpubackend::open(const string& _filename)
+{
+	this->filename = _filename;
+
+	if (Synthsource::isSynthetic(_filename))
+	{
+		this->synth = cv::makePtr<Synthsource>();
+		if (!this->synth->open(_filename))
+		{
+			cerr << "ERR::cannot open " << _filename << " as a synthetic video. Quitting..." << endl;
+			exit(-1);
+		}
+	}
+	else if (!this->cap.open(_filename))
+	{
+		cerr << "ERR::cannot open " << _filename << " with cv::VideoCapture. Quitting..." << endl;
+		exit(-1);
+	}
+}
+
+/**
+* Decode next frame
+*
+* cv::VideoCapture returns BGR (3 channels), unlike cudacodec that returns BGRA.
+* In keyframe mode, the next keyframe is decoded and the frame gets its frame number.
+*
+* @param _frame (Frame): the frame whose host matrix and timestamp are filled
+* @return (bool) false if no frame could be decoded
+*/
+bool Cpubackend::nextFrame(Frame& _frame)
+{
+#if USE_LIBAV
+	if (!this->keyframes.empty())
+		return this->keyframes->read(_frame.frame_cpu, _frame.count, _frame.timestamp);
+#endif
+
+	if (!this->synth.empty())
+	{
+		if (!this->synth->read(_frame.frame_cpu))
+			return false;
+
+		_frame.timestamp = this->synth->get(cv::CAP_PROP_POS_MSEC);
+		return true;
+	}
+
+	if (!this->cap.read(_frame.frame_cpu))
+		return false;
+
+	_frame.timestamp = this->cap.get(cv::CAP_PROP_POS_MSEC);
+	return true;
+}
+
+/**
+* Skip next frame
+*
+* The packet is decoded (later frames may depend on it) but not converted to BGR nor copied.
+*
+* @return (bool) false if there is no next frame
+*/
+bool Cpubackend::skipFrame()
+{
+#if USE_LIBAV
+	if (!this->keyframes.empty())
+		return true;		// non-key packets are dropped by the reader
+#endif
+
+	if (!this->synth.empty())
+		return this->synth->grab();
+
+	return this->cap.grab();
+}
+
+/**
+* Move the reader so that nextFrame() decodes frame _frame_n
+*
+* The decoder restarts from the previous keyframe and decodes up to _frame_n.
+*
+* @param _frame_n (int): frame index
+* @return (bool) false if the reader cannot seek
+*/
+bool Cpubackend::seek(const int& _frame_n)
+{
+#if USE_LIBAV
+	if (!this->keyframes.empty())
+		return this->keyframes->seek(_frame_n);
+#endif
+
+	if (!this->synth.empty())
+		return this->synth->seek(_frame_n);
+
+	return this->cap.set(cv::CAP_PROP_POS_FRAMES, _frame_n);
+}
+
+/**
+* Decode keyframes only
+*
+* The video is reopened with Keyframereader, which does not decode inter frames. Without libav
+* keyframes cannot be listed either (Videostream::findKeyframes): sampling analyzes every frame.
+*
+* @return (bool) false if keyframe-only decoding is not available
+*/
+bool Cpubackend::keyframesOnly()
+{
+	if (!this->synth.empty())
+		return false;		// generated, not decoded: nothing to save
+
+#if USE_LIBAV
+	cv::Ptr<Keyframereader> reader = cv::makePtr<Keyframereader>();
+	if (!reader->open(this->filename))
+		return false;
+
+	this->cap.release();
+	this->keyframes = reader;
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+* Image that does not come from the reader (benchmarks, synthetic sources)
+*
+* @param _frame (Frame): the frame whose host matrix is filled
+* @param _image (cv::Mat): BGR image, copied
+*/
+void Cpubackend::load(Frame& _frame, const cv::Mat& _image)
+{
+	_image.copyTo(_frame.frame_cpu);
+	Counters::bytes_copied.fetch_add(_image.total() * _image.elemSize(), memory_order_relaxed);
+}
+
+void Cpubackend::release()
+{
+	this->cap.release();
+	this->synth.release();
+#if USE_LIBAV
+	this->keyframes.release();
+#endif
+}
+
+/**
+* Analysis image on the host
+*
+* 2x and 4x downscales of 8 bit images use the box kernel in kernels.cpp, in parallel over
+* row bands (hardware counts of the bands: Bandcounter); other ratios use cv::resize with INTER_AREA.
+*
+* @param _frame (Frame): the frame, its decoded image is in native_cpu
+* @param _size (cv::Size): analysis size
+*/
+void Cpubackend::resize(Frame& _frame, const cv::Size& _size)
+{
+	const cv::Mat& src = _frame.native_cpu;
+	cv::Mat& dst = _frame.frame_cpu;
+	const int factor = src.cols / _size.width;
+
+	if ((factor == 2 || factor == 4) && src.cols == factor * _size.width && src.rows == factor * _size.height && src.depth() == CV_8U)
+	{
+		dst.create(_size, src.type());
+		const int rows = _size.height;
+		const int n_bands = max(1, min(cv::getNumThreads(), rows / RESIZE_BAND_ROWS));
+		Bandcounter band_counter;
+
+		cv::parallel_for_(cv::Range(0, n_bands), [&](const cv::Range& _range)
+		{
+			Bandcounter::Band band(band_counter);
+			for (int b = _range.start; b < _range.end; b++)
+				Kernels::boxDownRows(src.data, src.step, dst.data, dst.step, dst.cols, src.channels(), factor, rows * b / n_bands, rows * (b + 1) / n_bands);
+		});
+	}
+	else
+	{
+		cv::resize(src, dst, _size, 0, 0, cv::INTER_AREA);
+	}
+}
+
+/**
+* Grayscale plane on the host
+*
+* @param _frame (Frame): the frame whose gray plane is filled
+*/
+void Cpubackend::gray(Frame& _frame)
+{
+	Cpubackend::toGray(_frame.frame_cpu, _frame.gray_cpu);
+}
+
+/**
+* Features to track on the host
+*
+* @param _frame (Frame): the frame whose features are filled, from its gray plane
+*/
+void Cpubackend::features(Frame& _frame)
+{
+	cv::goodFeaturesToTrack(_frame.gray_cpu, _frame.pts_cpu, GFTT_MAX_CORNERS, GFTT_QUALITY, 0.0);
+}
+
+/**
+* Blur on the host
+*
+* Same definition as the cuda backend: for each patch, the variance of the pixels and the
+* variance of the 3x3 Laplacian. The Laplacian is saturated to CV_8U and the patch border is
+* reflected (BORDER_ISOLATED), as cuda filters do on a GpuMat ROI.
+* Instead of meanStdDev + Laplacian + meanStdDev per patch, the fused kernel reads each gray
+* row once for all patches. The ROI is split in row bands with their own accumulators,
+* which are summed afterwards, as their hardware counts (Bandcounter).
+*
+* @param _frame (Frame): the frame
+* @param _roi (cv Rect): user-defined region of interest of the image
+* @param _patch_info (int*): nx, ny, patch w, patch h
+* @param _blur_level (vector): output, (blur variance, pixel variance) for each patch, row-major
+*/
+void Cpubackend::blur(const Frame& _frame, const cv::Rect& _roi, const int _patch_info[], vector<pair<float, float>>& _blur_level)
+{
+	cv::Mat gray_mat = _frame.gray_cpu(_roi);
+
+	const int n_patch = _patch_info[0] * _patch_info[1];
+	const int rows = _patch_info[1] * _patch_info[3];
+	const int n_bands = max(1, min(cv::getNumThreads(), rows / BLUR_BAND_ROWS));
+	vector<Tblurstats> band_stats(n_bands * n_patch, Tblurstats{ 0, 0, 0, 0 });
+	Bandcounter band_counter;
+
+	cv::parallel_for_(cv::Range(0, n_bands), [&](const cv::Range& _range)
+	{
+		Bandcounter::Band band(band_counter);
+		for (int b = _range.start; b < _range.end; b++)
+			Kernels::blurRows(gray_mat.data, gray_mat.step, _patch_info, rows * b / n_bands, rows * (b + 1) / n_bands, &band_stats[b * n_patch]);
+	});
+
+	_blur_level.assign(n_patch, pair<float, float>(0.0f, 0.0f));
+	for (int i = 0; i < n_patch; i++)
+	{
+		Tblurstats acc = { 0, 0, 0, 0 };
+		for (int b = 0; b < n_bands; b++)
+		{
+			acc.pix_sum += band_stats[b * n_patch + i].pix_sum;
+			acc.pix_sqsum += band_stats[b * n_patch + i].pix_sqsum;
+			acc.lap_sum += band_stats[b * n_patch + i].lap_sum;
+			acc.lap_sqsum += band_stats[b * n_patch + i].lap_sqsum;
+		}
+
+		Kernels::blurVariance(acc, _patch_info[2] * _patch_info[3], _blur_level[i].first, _blur_level[i].second);
+	}
+}
+
+/**
+* Histogram on the host
+*
+* The V channel is binned straight from the BGR(A) pixels (V = max(B, G, R)) with the
+* kernel in kernels.cpp, in parallel over row bands (hardware counts: Bandcounter). Other
+* channels go through the full HSV conversion. Bin edges are the integer even levels used by
+* cuda::histEven (i * 256 / bins), so that a coarse histogram is binned exactly like on the GPU.
+*
+* @param _frame (Frame): the frame
+* @param ch_number: (int) the HSV channel of the considered histogram
+* @param bin_number: (int) the number of bins of the histogram
+* @return (cv::Mat) bins x 1, CV_32S
+*/
+cv::Mat Cpubackend::hist(const Frame& _frame, const int& ch_number, const int& _bin_number)
+{
+	const cv::Mat& src = _frame.frame_cpu;
+
+	if (ch_number == V_CHANNEL)
+	{
+		const int n_bands = max(1, min(cv::getNumThreads(), src.rows / HIST_BAND_ROWS));
+		vector<uint32_t> band_hist(n_bands * MAX_BIN_NUMBER, 0);
+		cv::Mat hist_full = cv::Mat::zeros(MAX_BIN_NUMBER, 1, CV_32S);
+		Bandcounter band_counter;
+
+		cv::parallel_for_(cv::Range(0, n_bands), [&](const cv::Range& _range)
+		{
+			Bandcounter::Band band(band_counter);
+			for (int b = _range.start; b < _range.end; b++)
+				Kernels::histVRows(src.data, src.step, src.cols, src.channels(), src.rows * b / n_bands, src.rows * (b + 1) / n_bands, &band_hist[b * MAX_BIN_NUMBER]);
+		});
+
+		for (int b = 0; b < n_bands; b++)
+			for (int i = 0; i < MAX_BIN_NUMBER; i++)
+				hist_full.at<int>(i, 0) += static_cast<int>(band_hist[b * MAX_BIN_NUMBER + i]);
+
+		if (_bin_number == MAX_BIN_NUMBER)
+			return hist_full;
+
+		return Frame::foldHist(hist_full, _bin_number);
+	}
+
+	cv::Mat bgr_mat, hsv_mat, ch_mat, hist_f, hist_cpu;
+
+	if (src.channels() == 4)
+		cv::cvtColor(src, bgr_mat, cv::COLOR_BGRA2BGR, 3);
+	else
+		bgr_mat = src;
+
+	cv::cvtColor(bgr_mat, hsv_mat, cv::COLOR_BGR2HSV, 3);
+	cv::extractChannel(hsv_mat, ch_mat, ch_number);
+
+	vector<float> levels(_bin_number + 1);
+	for (int i = 0; i <= _bin_number; i++)
+		levels[i] = static_cast<float>(i * MAX_BIN_NUMBER / _bin_number);
+
+	const float* ranges[] = { levels.data() };
+	int channels[] = { 0 };
+	cv::calcHist(&ch_mat, 1, channels, cv::Mat(), hist_f, 1, &_bin_number, ranges, false);
+
+	hist_f.convertTo(hist_cpu, CV_32S);
+	return hist_cpu;
+}
+
+/**
+* Motion on the host
+*
+* Good features to track of the previous frame, sparse pyramidal Lucas-Kanade towards the next
+* one, and the squared L2 norm of the displacement of all points (as in the cuda backend).
+*
+* @param _prev (Frame): second to last frame
+* @param _next (Frame): last frame
+* @return (float) amount of motion
+*/
+float Cpubackend::motion(const Frame& _prev, const Frame& _next)
+{
+	const cv::Mat& frame_gray_prev = _prev.gray_cpu;
+	const cv::Mat& frame_gray_next = _next.gray_cpu;
+	const vector<cv::Point2f>& prevPts = _prev.pts_cpu;
+	vector<cv::Point2f> nextPts;
+	vector<uchar> status;
+	vector<float> err;
+
+	if (prevPts.empty())
+		return 0.0f;
+
+	cv::calcOpticalFlowPyrLK(frame_gray_prev, frame_gray_next, prevPts, nextPts, status, err,
+		cv::Size(LK_WIN, LK_WIN), LK_MAX_LEVEL, cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, LK_ITERS, 0.01));
+
+	double norm = 0.;
+	for (size_t i = 0; i < prevPts.size(); i++)
+	{
+		double dx = prevPts[i].x - nextPts[i].x;
+		double dy = prevPts[i].y - nextPts[i].y;
+		norm += dx * dx + dy * dy;
+	}
+
+	return static_cast<float>(norm);
+}
+
+void Cpubackend::openWindow(const string& _window_name, const int& _w, const int& _h)
+{
+	cv::namedWindow(_window_name, cv::WINDOW_NORMAL);
+	cv::resizeWindow(_window_name, _w, _h);
+}
+
+void Cpubackend::show(const string& _window_name, const Frame& _frame)
+{
+	cv::imshow(_window_name, _frame.frame_cpu);
+}
+
+string Cpubackend::getName() const
+{
+	return BACKEND_CPU;
+}
+
+/**
+* Analysis workers supported by the backend
+*
+* The host metrics are stateless, any number of workers can call them concurrently.
+*
+* @return (int) maximum number of analysis workers
+*/
+int Cpubackend::maxWorkers() const
+{
+	return numeric_limits<int>::max();
+}
+
+/**
+* Grayscale conversion for BGR (VideoCapture) or BGRA input
+*
+* @param _src (cv::Mat): 3 or 4 channels image
+* @param _dst (cv::Mat): 1 channel image
+*/
+void Cpubackend::toGray(const cv::Mat& _src, cv::Mat& _dst)
+{
+	cv::cvtColor(_src, _dst, _src.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY, 1);
+}
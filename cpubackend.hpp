@@ -0,0 +1,79 @@
+#ifndef __CPUBACKEND_H__
+#define __CPUBACKEND_H__
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/utility.hpp>	// parallel_for_
+#include <opencv2/imgproc.hpp>		// cvtColor, Laplacian, calcHist
+#include <opencv2/videoio.hpp>
+#include <opencv2/video/tracking.hpp>	// calcOpticalFlowPyrLK
+#include <opencv2/highgui.hpp>
+#include <limits>
+
+#include "backend.hpp"
+#include "frame.h"
+#include "kernels.hpp"
+#include "keyframereader.hpp"
+#include "synthsource.hpp"
+
+// same defaults as cuda::createGoodFeaturesToTrackDetector and cuda::SparsePyrLKOpticalFlow
+#define GFTT_MAX_CORNERS 1000
+#define GFTT_QUALITY 0.01
+#define LK_WIN 21
+#define LK_MAX_LEVEL 3
+#define LK_ITERS 30
+
+#define BLUR_BAND_ROWS 64	// minimum rows per parallel blur band
+#define HIST_BAND_ROWS 64	// minimum rows per parallel histogram band
+#define RESIZE_BAND_ROWS 32	// minimum output rows per parallel downscale band
+
+using namespace std;
+
+/**
+* Host backend
+*
+* cv::Mat implementation of the metrics for machines without a GPU. OpenCV's host functions
+* are vectorized and multi-threaded internally; the custom kernels (kernels.hpp) are spread
+* over row bands with parallel_for_.
+*/
+class Cpubackend : public Backend
+{
+private:
+	cv::VideoCapture cap;
+	cv::Ptr<Synthsource> synth;				// .synth files, replaces cap
+	string filename;
+#if USE_LIBAV
+	cv::Ptr<Keyframereader> keyframes;		// set by keyframesOnly(), replaces cap
+#endif
+
+public:
+	// Constructors
+	Cpubackend();
+
+	// methods::source
+	void open(const string& _filename) override;
+	bool nextFrame(Frame& _frame) override;
+	bool skipFrame() override;
+	bool seek(const int& _frame_n) override;
+	bool keyframesOnly() override;
+	void load(Frame& _frame, const cv::Mat& _image) override;
+	void release() override;
+
+	// methods::metrics
+	void resize(Frame& _frame, const cv::Size& _size) override;
+	void gray(Frame& _frame) override;
+	void features(Frame& _frame) override;
+	void blur(const Frame& _frame, const cv::Rect& _roi, const int _patch_info[], vector<pair<float, float>>& _blur_level) override;
+	cv::Mat hist(const Frame& _frame, const int& ch_number, const int& _bin_number) override;
+	float motion(const Frame& _prev, const Frame& _next) override;
+
+	// methods::display
+	void openWindow(const string& _window_name, const int& _w, const int& _h) override;
+	void show(const string& _window_name, const Frame& _frame) override;
+
+	// methods::other
+	string getName() const override;
+	int maxWorkers() const override;
+	static void toGray(const cv::Mat& _src, cv::Mat& _dst);
+};
+
+#endif
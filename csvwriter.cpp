@@ -0,0 +1,351 @@
+#include "csvwriter.hpp"
+
+Csvwriter::Csvwriter()
+{
+	this->front = 0;
+	this->in_flight = false;
+}
+
+Csvwriter::~Csvwriter()
+{
+	this->close();
+}
+
+/**
+* Process-wide flusher: its thread, job queue and the registry of open writers
+*
+* Created on first use and never destroyed, so that it is still valid in the exit handlers.
+*/
+Csvwriter::Tflusher& Csvwriter::flusher()
+{
+	static Tflusher* instance = []
+	{
+		Tflusher* f = new Tflusher();
+		thread(&Csvwriter::flusherLoop).detach();
+
+		atexit(&Csvwriter::flushAll);
+		set_terminate([]
+		{
+			Csvwriter::flushAll();
+			abort();
+		});
+
+		return f;
+	}();
+
+	return *instance;
+}
+
+/**
+* Write the buffers handed off, and every half period hand off the stale ones
+*/
+void Csvwriter::flusherLoop()
+{
+	Tflusher& f = Csvwriter::flusher();
+	chrono::steady_clock::time_point last_scan = chrono::steady_clock::now();
+
+	while (true)
+	{
+		Csvwriter* writer = nullptr;
+		{
+			unique_lock<mutex> lk(f.lock);
+			f.cv.wait_for(lk, chrono::milliseconds(CSV_FLUSH_MS / 2), [&f] { return !f.jobs.empty(); });
+			if (!f.jobs.empty())
+			{
+				writer = f.jobs.front();
+				f.jobs.pop_front();
+			}
+		}
+
+		if (writer != nullptr)
+			writer->writeBack();
+
+		if (chrono::steady_clock::now() - last_scan >= chrono::milliseconds(CSV_FLUSH_MS / 2))
+		{
+			Csvwriter::handOffStale();
+			last_scan = chrono::steady_clock::now();
+		}
+	}
+}
+
+/**
+* Hand off the buffers of open writers that have not been written for CSV_FLUSH_MS (flusher thread)
+*
+* A buffer already in flight is skipped: its job is queued and the next scan sees the new one.
+*/
+void Csvwriter::handOffStale()
+{
+	Tflusher& f = Csvwriter::flusher();
+	lock_guard<mutex> registry_lk(f.registry_lock);
+	const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+
+	for (Csvwriter* writer : f.registry)
+	{
+		unique_lock<mutex> lk(writer->lock);
+		if (writer->in_flight)
+			continue;
+
+		bool stale;
+		{
+			lock_guard<mutex> front_lk(writer->front_lock);
+			stale = !writer->buffers[writer->front].empty() && now - writer->last_flush >= chrono::milliseconds(CSV_FLUSH_MS);
+		}
+
+		if (stale)
+			writer->handOff(lk);
+	}
+}
+
+/**
+* Flush every open writer (exit handlers)
+*/
+void Csvwriter::flushAll()
+{
+	Tflusher& f = Csvwriter::flusher();
+	lock_guard<mutex> lk(f.registry_lock);
+
+	for (Csvwriter* writer : f.registry)
+		writer->writeAll(true);
+}
+
+/**
+* Write the back buffer to the file (flusher thread)
+*
+* The caller keeps appending lines to the front buffer meanwhile (front_lock).
+*/
+void Csvwriter::writeBack()
+{
+	lock_guard<mutex> lk(this->lock);
+	vector<char>& back = this->buffers[1 - this->front];
+
+	this->file.write(back.data(), back.size());
+	this->file.flush();
+	back.clear();		// capacity is kept
+
+	this->in_flight = false;
+	this->cv.notify_all();
+}
+
+/**
+* Swap the buffers and give the filled one to the flusher
+*
+* Waits if the previous one is still being written.
+*
+* @param _lk (unique_lock): held on this->lock
+*/
+void Csvwriter::handOff(unique_lock<mutex>& _lk)
+{
+	this->cv.wait(_lk, [this] { return !this->in_flight; });
+	{
+		lock_guard<mutex> lk(this->front_lock);
+		this->front = 1 - this->front;
+		this->last_flush = chrono::steady_clock::now();
+	}
+	this->in_flight = true;
+
+	Tflusher& f = Csvwriter::flusher();
+	{
+		lock_guard<mutex> lk(f.lock);
+		f.jobs.push_back(this);
+	}
+	f.cv.notify_one();
+}
+
+/**
+* Open the file
+*
+* @param _path (string): file path
+* @param _append (bool): append to the file instead of truncating it
+*/
+void Csvwriter::open(const string& _path, const bool& _append)
+{
+	this->close();
+
+	this->file.open(_path, _append ? ios_base::app : ios_base::trunc);
+	if (!this->file.is_open())
+	{
+		cerr << "ERR::cannot open " << _path << ". Quitting..." << endl;
+		exit(-1);
+	}
+
+	this->path = _path;
+	this->line.clear();
+	this->line.reserve(4096);
+	for (int i = 0; i < 2; i++)
+	{
+		this->buffers[i].clear();
+		this->buffers[i].reserve(CSV_BUFFER_SIZE + 4096);	// room for the line that crosses the threshold
+	}
+	this->last_flush = chrono::steady_clock::now();
+
+	Tflusher& f = Csvwriter::flusher();
+	lock_guard<mutex> lk(f.registry_lock);
+	f.registry.insert(this);
+}
+
+/**
+* Flush and close the file (no-op if not open)
+*/
+void Csvwriter::close()
+{
+	if (!this->isOpen())
+		return;
+
+	{
+		Tflusher& f = Csvwriter::flusher();
+		lock_guard<mutex> lk(f.registry_lock);
+		f.registry.erase(this);
+	}
+
+	this->flush();
+	this->file.close();
+	this->path.clear();
+}
+
+/**
+* Write everything to the file, synchronously
+*
+* Waits for the back buffer, so that the file is complete and in order when this returns
+* (checkpoints read its size right after). A line not ended yet is written too.
+*/
+void Csvwriter::flush()
+{
+	if (!this->line.empty())
+		this->appendLine();
+
+	this->writeAll(false);
+}
+
+/**
+* Write the back buffer, then the front one
+*
+* @param _bounded (bool): exit handlers only; the flusher may be gone, so after a while the
+*        back buffer is written here. The flusher writes it under the same lock, so it has not
+*        started yet: once cleared, its job writes nothing.
+*/
+void Csvwriter::writeAll(const bool& _bounded)
+{
+	unique_lock<mutex> lk(this->lock);
+	if (!this->file.is_open())
+		return;
+
+	if (!_bounded)
+	{
+		this->cv.wait(lk, [this] { return !this->in_flight; });
+	}
+	else if (!this->cv.wait_for(lk, chrono::seconds(1), [this] { return !this->in_flight; }))
+	{
+		vector<char>& back = this->buffers[1 - this->front];
+		this->file.write(back.data(), back.size());
+		back.clear();
+		this->in_flight = false;
+	}
+
+	lock_guard<mutex> front_lk(this->front_lock);
+	vector<char>& buf = this->buffers[this->front];
+	this->file.write(buf.data(), buf.size());
+	this->file.flush();
+	buf.clear();
+}
+
+/**
+* Append the content of another file
+*
+* @param _path (string): the file to copy at the end of this one
+*/
+void Csvwriter::appendFile(const string& _path)
+{
+	this->flush();
+
+	ifstream src(_path);
+	lock_guard<mutex> lk(this->lock);
+	if (src.peek() != ifstream::traits_type::eof())
+		this->file << src.rdbuf();
+}
+
+bool Csvwriter::isOpen() const
+{
+	return this->file.is_open();
+}
+
+Csvwriter& Csvwriter::operator<<(const int& _val)
+{
+	char tmp[16];
+	to_chars_result res = to_chars(tmp, tmp + sizeof(tmp), _val);
+	this->line.insert(this->line.end(), tmp, res.ptr);
+	return *this;
+}
+
+Csvwriter& Csvwriter::operator<<(const long& _val)
+{
+	char tmp[24];
+	to_chars_result res = to_chars(tmp, tmp + sizeof(tmp), _val);
+	this->line.insert(this->line.end(), tmp, res.ptr);
+	return *this;
+}
+
+Csvwriter& Csvwriter::operator<<(const float& _val)
+{
+	char tmp[32];
+	to_chars_result res = to_chars(tmp, tmp + sizeof(tmp), _val, chars_format::general, CSV_FLOAT_DIGITS);
+	this->line.insert(this->line.end(), tmp, res.ptr);
+	return *this;
+}
+
+Csvwriter& Csvwriter::operator<<(const double& _val)
+{
+	char tmp[32];
+	to_chars_result res = to_chars(tmp, tmp + sizeof(tmp), _val, chars_format::general, CSV_FLOAT_DIGITS);
+	this->line.insert(this->line.end(), tmp, res.ptr);
+	return *this;
+}
+
+Csvwriter& Csvwriter::operator<<(const char& _val)
+{
+	this->line.push_back(_val);
+	return *this;
+}
+
+Csvwriter& Csvwriter::operator<<(const char* _val)
+{
+	while (*_val != '\0')
+		this->line.push_back(*_val++);
+	return *this;
+}
+
+Csvwriter& Csvwriter::operator<<(const string& _val)
+{
+	this->line.insert(this->line.end(), _val.begin(), _val.end());
+	return *this;
+}
+
+/**
+* Move the formatted line to the front buffer
+*
+* @return (bool) true if the front buffer is full
+*/
+bool Csvwriter::appendLine()
+{
+	lock_guard<mutex> lk(this->front_lock);
+	vector<char>& buf = this->buffers[this->front];
+	buf.insert(buf.end(), this->line.begin(), this->line.end());
+	this->line.clear();
+
+	return buf.size() >= CSV_BUFFER_SIZE;
+}
+
+/**
+* End of line: the line joins the front buffer, which goes to the flusher if full
+*
+* Buffers that stop growing are handed off by the flusher (handOffStale).
+*/
+void Csvwriter::endLine()
+{
+	this->line.push_back('\n');
+
+	if (this->appendLine())
+	{
+		unique_lock<mutex> lk(this->lock);
+		this->handOff(lk);
+	}
+}
@@ -0,0 +1,92 @@
+#ifndef __CSVWRITER_H__
+#define __CSVWRITER_H__
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <charconv>
+#include <exception>
+#include <cstdlib>
+
+#define CSV_BUFFER_SIZE (1 << 20)	// bytes: a full buffer is handed to the flusher
+#define CSV_FLUSH_MS 1000			// a buffer older than this is handed to the flusher anyway (checked every half period)
+#define CSV_FLOAT_DIGITS 6			// same as the default precision of iostream
+
+using namespace std;
+
+/**
+* Buffered CSV writer
+*
+* Values are formatted with to_chars (no locale, no allocation) into a line buffer, and complete
+* lines are appended to a large reusable buffer. When the buffer is full it is handed to a
+* background thread that writes it to the file, while the caller keeps filling the other buffer
+* (double buffering). The same thread hands off buffers older than CSV_FLUSH_MS, so rows reach
+* the file even if the caller stalls. Numbers are the same as `ofstream <<` (%g, 6 digits).
+* Open writers are flushed at exit (also exit() on error) and on std::terminate.
+*/
+class Csvwriter
+{
+private:
+	typedef struct
+	{
+		mutex lock;
+		condition_variable cv;
+		deque<Csvwriter*> jobs;		// writers with a back buffer to write
+		mutex registry_lock;
+		set<Csvwriter*> registry;	// open writers
+	}Tflusher;
+
+	ofstream file;
+	string path;
+	vector<char> line;				// line being formatted, caller only
+	vector<char> buffers[2];
+	int front;						// buffer receiving complete lines
+	bool in_flight;					// back buffer handed to the flusher, not written yet
+	mutex lock;						// in_flight, back buffer, file
+	mutex front_lock;				// front buffer, last_flush; taken after lock (both for the swap)
+	condition_variable cv;
+	chrono::steady_clock::time_point last_flush;
+
+	static Tflusher& flusher();
+	static void flusherLoop();
+	static void flushAll();
+	static void handOffStale();
+	void handOff(unique_lock<mutex>& _lk);
+	bool appendLine();
+	void writeBack();
+	void writeAll(const bool& _bounded);
+
+public:
+	// Constructors
+	Csvwriter();
+	~Csvwriter();
+
+	Csvwriter(const Csvwriter&) = delete;
+	Csvwriter& operator=(const Csvwriter&) = delete;
+
+	// methods
+	void open(const string& _path, const bool& _append);
+	void close();
+	void flush();
+	void appendFile(const string& _path);
+	bool isOpen() const;
+
+	// methods::formatting
+	Csvwriter& operator<<(const int& _val);
+	Csvwriter& operator<<(const long& _val);
+	Csvwriter& operator<<(const float& _val);
+	Csvwriter& operator<<(const double& _val);
+	Csvwriter& operator<<(const char& _val);
+	Csvwriter& operator<<(const char* _val);
+	Csvwriter& operator<<(const string& _val);
+	void endLine();
+};
+
+#endif
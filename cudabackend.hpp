@@ -0,0 +1,75 @@
+#ifndef __CUDABACKEND_H__
+#define __CUDABACKEND_H__
+
+#include "backend.hpp"
+
+#if USE_CUDA
+
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <opencv2/cudacodec.hpp>
+#include <opencv2/highgui.hpp>
+#include <opencv2/cudafilters.hpp>	// sobel
+#include <opencv2/cudaarithm.hpp>	// cuda::norm
+#include <opencv2/cudaimgproc.hpp>	// cuda::cvtcolor
+#include <opencv2/cudaoptflow.hpp>
+#include <opencv2/cudawarping.hpp>	// cuda::resize
+#include <opencv2/core/opengl.hpp>
+
+#include "frame.h"
+#include "synthsource.hpp"
+
+using namespace std;
+
+/**
+* Cuda backend
+*
+* The original GPU implementation: cudacodec for decoding (BGRA frames), cuda filters,
+* histograms and sparse optical flow for the metrics.
+* Decoder, worker and writer threads share the backend: every call that touches the device
+* holds a lock, since filters, detectors and the default stream are not thread-safe.
+*/
+class Cudabackend : public Backend
+{
+private:
+	cv::Ptr<cv::cudacodec::VideoReader> cap;
+	cv::Ptr<Synthsource> synth;			// .synth files, replaces cap
+	cv::Mat synth_cpu;					// generated frame, before upload
+	cv::Ptr<cv::cuda::Filter> lap;
+	cv::Ptr<cv::cuda::CornersDetector> corner_det;
+	cv::Ptr<cv::cuda::SparsePyrLKOpticalFlow> pyrLK_sparse;
+	mutex device;						// serializes the device work of the pipeline threads
+
+public:
+	// Constructors
+	Cudabackend();
+
+	// methods::source
+	void open(const string& _filename) override;
+	bool nextFrame(Frame& _frame) override;
+	bool skipFrame() override;
+	bool seek(const int& _frame_n) override;
+	bool keyframesOnly() override;
+	void load(Frame& _frame, const cv::Mat& _image) override;
+	void release() override;
+
+	// methods::metrics
+	void resize(Frame& _frame, const cv::Size& _size) override;
+	void gray(Frame& _frame) override;
+	void features(Frame& _frame) override;
+	void blur(const Frame& _frame, const cv::Rect& _roi, const int _patch_info[], vector<pair<float, float>>& _blur_level) override;
+	cv::Mat hist(const Frame& _frame, const int& ch_number, const int& _bin_number) override;
+	float motion(const Frame& _prev, const Frame& _next) override;
+
+	// methods::display
+	void openWindow(const string& _window_name, const int& _w, const int& _h) override;
+	void show(const string& _window_name, const Frame& _frame) override;
+
+	// methods::other
+	string getName() const override;
+	int maxWorkers() const override;
+};
+
+#endif
+
+#endif
@@ -2,17 +2,182 @@
 
 Frame::Frame()
 {
+	this->frame_cpu = cv::Mat();
+#if USE_CUDA
 	this->frame_gpu = cv::cuda::GpuMat();
+#endif
+	this->scaled = false;
 	this->count = -1;
+	this->timestamp = -1.0;
+	this->gray_ready = false;
+	this->pts_ready = false;
+	this->hist_ch = -1;
+	this->pyramid_ready = 0;
 }
 
-Frame::Frame(cv::cuda::GpuMat& _gpu_mat, int _count)
+/**
+* Recycle the frame for a new image
+*
+* Frames live in the slots of a Ringbuffer and are decoded in place: the image, gray and
+* histogram buffers are kept (same size, no reallocation) while the results and the cache
+* flags are cleared. A downscaled frame gets its decoding buffer back.
+*
+* @param _count (int): frame number of the image that is going to be decoded
+*/
+void Frame::reset(const int& _count)
 {
-	_gpu_mat.copyTo(this->frame_gpu);
+	if (this->scaled)
+	{
+		swap(this->frame_cpu, this->native_cpu);
+#if USE_CUDA
+		swap(this->frame_gpu, this->native_gpu);
+#endif
+		this->scaled = false;
+	}
+
 	this->count = _count; 
+	this->timestamp = -1.0;
+	this->gray_ready = false;
+	this->pts_ready = false;
+	this->hist_ch = -1;
+	this->blur_level.clear();
 	this->exposure_level = 0.0f;
 	this->entropy_level = 0.0f;
 	this->motion = 0.0f;
+	this->pyramid_ready = 0;
+	for (size_t i = 0; i < this->rows.size(); i++)
+		this->rows[i].clear();
+}
+
+/**
+* Swap everything but the image with another frame
+*
+* Frames are decoded and analyzed in a pool; once a frame is committed in order, its derived
+* products (gray plane, histogram, features) and results move into the history slot, which
+* hands back its old buffers for reuse. Nothing is copied and the history never holds a
+* full-resolution colour image.
+*
+* @param _other (Frame): the frame to swap with
+*/
+void Frame::swapProducts(Frame& _other)
+{
+	swap(this->count, _other.count);
+	swap(this->timestamp, _other.timestamp);
+	swap(this->gray_cpu, _other.gray_cpu);
+#if USE_CUDA
+	swap(this->gray_gpu, _other.gray_gpu);
+	swap(this->pts_gpu, _other.pts_gpu);
+#endif
+	swap(this->gray_ready, _other.gray_ready);
+	swap(this->pts_cpu, _other.pts_cpu);
+	swap(this->pts_ready, _other.pts_ready);
+	swap(this->hist_full, _other.hist_full);
+	swap(this->hist_ch, _other.hist_ch);
+	swap(this->blur_level, _other.blur_level);
+	swap(this->exposure_level, _other.exposure_level);
+	swap(this->entropy_level, _other.entropy_level);
+	swap(this->motion, _other.motion);
+	swap(this->pyramid, _other.pyramid);
+	swap(this->pyramid_ready, _other.pyramid_ready);
+	swap(this->rows, _other.rows);
+}
+
+/**
+* Memory held by the frame
+*
+* @return (size_t) bytes of image, gray plane, features and histogram buffers
+*/
+size_t Frame::getBytes() const
+{
+	size_t bytes = this->frame_cpu.total() * this->frame_cpu.elemSize()
+		+ this->native_cpu.total() * this->native_cpu.elemSize()
+		+ this->gray_cpu.total() * this->gray_cpu.elemSize()
+		+ this->pts_cpu.capacity() * sizeof(cv::Point2f)
+		+ this->hist_full.total() * this->hist_full.elemSize();
+#if USE_CUDA
+	bytes += this->frame_gpu.rows * this->frame_gpu.step
+		+ this->native_gpu.rows * this->native_gpu.step
+		+ this->gray_gpu.rows * this->gray_gpu.step
+		+ this->pts_gpu.rows * this->pts_gpu.step;
+#endif
+	for (size_t i = 0; i < this->pyramid.size(); i++)
+		bytes += this->pyramid[i].getBytes();
+
+	return bytes;
+}
+
+/**
+* Scale the image to the analysis size
+*
+* Must run before any metric. The decoded image moves to native_cpu (native_gpu) and the
+* scaled one takes its place, so that every metric reads the analysis image; both buffers
+* are kept for the next frames.
+*
+* @param _be (Backend): compute backend
+* @param _size (cv::Size): analysis size; nothing to do if it is the decoded size
+*/
+void Frame::downscale(Backend& _be, const cv::Size& _size)
+{
+	cv::Size size = getImageSize();
+
+	if (this->scaled || size == _size || size.area() == 0)
+		return;
+
+	swap(this->frame_cpu, this->native_cpu);
+#if USE_CUDA
+	swap(this->frame_gpu, this->native_gpu);
+#endif
+	this->scaled = true;
+
+	Stagetimer timer(STAGE_RESIZE, this->count);
+	_be.resize(*this, _size);
+}
+
+/**
+* Pyramid level of the image
+*
+* Level 0 is the frame itself, level k is level k - 1 halved (box filter for even sizes, see
+* Backend::resize). Levels are built on first use, once per image, and each one caches its
+* own gray plane, histogram and features, so metrics at the same level share them. Levels
+* move with the products into the history (swapProducts): motion finds the previous frame's.
+*
+* @param _be (Backend): compute backend
+* @param _level (int): pyramid level
+* @return (Frame) the level; only its image and products are meaningful
+*/
+Frame& Frame::getLevel(Backend& _be, const int& _level)
+{
+	if (_level <= 0)
+		return *this;
+
+	if (static_cast<int>(this->pyramid.size()) < _level)
+		this->pyramid.resize(_level);
+
+	Frame& level = this->pyramid[_level - 1];
+	if (this->pyramid_ready >= _level)
+		return level;
+
+	Frame& upper = getLevel(_be, _level - 1);
+	cv::Size size = upper.getImageSize();
+	size = cv::Size(max(1, size.width / 2), max(1, size.height / 2));
+
+	// the upper image is the source of the resize: shared, not copied
+	level.reset(this->count);
+	level.native_cpu = upper.frame_cpu;
+#if USE_CUDA
+	level.native_gpu = upper.frame_gpu;
+#endif
+	{
+		Stagetimer timer(STAGE_RESIZE, this->count);
+		_be.resize(level, size);
+	}
+	level.native_cpu = cv::Mat();
+#if USE_CUDA
+	level.native_gpu = cv::cuda::GpuMat();
+#endif
+
+	this->pyramid_ready = _level;
+	return level;
 }
 
 /**
@@ -23,61 +188,37 @@ Frame::Frame(cv::cuda::GpuMat& _gpu_mat, int _count)
 * the lower the value (variance), the higher the blurriness.
 * The function could work on all channels, yet grayscale only is faster.
 * 
-* @param _lap (cuda Filter): laplacian filter
+* @param _be (Backend): compute backend
+* @param _src (Frame): pyramid level of this frame, its gray plane computed (Framecontext::gray)
 * @param _roi (cv Rect): user-defined region of interest of the image
-* @param _patch_info (int*): nx, ny, patch w, patch h
+* @param _patch_info (int*): nx, ny, patch w, patch h, in pixels of the level
 * 
 * @see [original code](https://stackoverflow.com/questions/63508517/opencv-cuda-laplacian-filter-on-3-channel-image)
 * @see [built-in function](https://docs.opencv.org/3.4/dc/d66/group__cudafilters.html#ga53126e88bb7e6185dcd5628e28e42cd2)
 */
-void Frame::computeBlur(cv::Ptr<cv::cuda::Filter>& _lap, const cv::Rect& _roi, const int _patch_info[])
+void Frame::computeBlur(Backend& _be, const Frame& _src, const cv::Rect& _roi, const int _patch_info[])
 {
-	cv::cuda::GpuMat gray_mat, patch_mat;
-	cv::cuda::cvtColor(this->frame_gpu, gray_mat, cv::COLOR_BGRA2GRAY, 1);
-	cv::Scalar mean_blur, mean_pix, std_blur, std_pix;
-	
-	// reduce matrix to ROI (defined in input)
-	gray_mat = gray_mat(_roi);
-
-	// work on patches
-	for (int y = 0; y < _patch_info[1]; y++)
-	{
-		for (int x = 0; x < _patch_info[0]; x++)
-		{
-			cv::Rect patch_roi = cv::Rect(x * _patch_info[2], y * _patch_info[3], _patch_info[2], _patch_info[3]);
-			patch_mat = gray_mat(patch_roi);
-
-			//pixel variance
-			cv::cuda::meanStdDev(patch_mat, mean_pix, std_pix);
-			float variance_pixel = static_cast<float>(std_pix[0] * std_pix[0]); // variance is the squared of std
-
-			// blur variance
-			_lap->apply(patch_mat, patch_mat);
-			cv::cuda::meanStdDev(patch_mat, mean_blur, std_blur);
-			float variance_blur = static_cast<float>(std_blur[0] * std_blur[0]);
-			
-			this->blur_level.push_back(pair(variance_blur, variance_pixel));
-		}
-	}
+	Stagetimer timer(STAGE_BLUR, this->count);
+	_be.blur(_src, _roi, _patch_info, this->blur_level);
 }
 
 /**
 * Compute exposure value
 * 
-* The function firstly computes the histogram for the required number of bins (3).
-* Afterwards, the exposure is seen as the difference between the highest and lowest bin (among the 3).
+* The histogram has MIN_BIN_NUMBER bins.
+* The exposure is seen as the difference between the highest and lowest bin.
 * Since it is only meant to catch high distortion, it implements the formula:
 * (high - min) * (1 - high - mid/2)
 * If the returned value is negative, it means the low value component are the predominant ones.
 * The multiplied component is used to enhance strong difference between high and low.
 * 
-* @param ch_number: (int) the channel of the considered histogram
-* @param bin_number: (int) the number of bins of the histogram
-* @param area: (double) the number of pixels in the original matrix (normalization)
+* @param _hist (cv::Mat): V histogram of the level, MIN_BIN_NUMBER x 1, CV_32S (Framecontext::hist)
+* @param area: (double) the number of pixels in the matrix of the level (normalization)
 */
-void Frame::computeExposure(const int& ch_number, const int& _bin_number, const double& _area)
+void Frame::computeExposure(const cv::Mat& _hist, const double& _area)
 {
-	cv::Mat hist_cpu = computeHist(ch_number, _bin_number);
+	Stagetimer timer(STAGE_EXPOSURE, this->count);
+	const cv::Mat& hist_cpu = _hist;
 
 	// init
 	int lst = MIN_BIN_NUMBER - 1;
@@ -102,22 +243,21 @@ void Frame::computeExposure(const int& ch_number, const int& _bin_number, const
 /**
 * Compute entropy value for a given channel
 *
-* The function firstly computes the histogram for the required number of bins (256).
-* Afterwards, it implements the Shannon entropy on the specified channel
+* The histogram has the full MAX_BIN_NUMBER bins.
+* It implements the Shannon entropy on the channel of the histogram
 *
-* @param ch_number: (int) the channel of the considered histogram
-* @param bin_number: (int) the number of bins of the histogram
-* @param area: (double) the number of pixels in the original matrix (normalization)
+* @param _hist (cv::Mat): V histogram of the level, bins x 1, CV_32S (Framecontext::hist)
+* @param area: (double) the number of pixels in the matrix of the level (normalization)
 * 
 * @see[implementation](https://stackoverflow.com/a/24930922)
 * @see[theory](https://stackoverflow.com/a/40660371)
 */
-void Frame::computeEntropy(const int& ch_number, const int& _bin_number, const double& _area)
+void Frame::computeEntropy(const cv::Mat& _hist, const double& _area)
 {
+	Stagetimer timer(STAGE_ENTROPY, this->count);
 	cv::Mat hist_cpu, logP;
 
-	hist_cpu = computeHist(ch_number, _bin_number);
-	hist_cpu.convertTo(hist_cpu, CV_64FC1);
+	_hist.convertTo(hist_cpu, CV_64FC1);
 	hist_cpu /= _area;
 	hist_cpu += 1e-4; //prevent 0
 
@@ -132,77 +272,136 @@ void Frame::computeEntropy(const int& ch_number, const int& _bin_number, const d
 * and generally more accurate than full pixels analysis. The final result is computed as
 * the norm of the difference between the position of the points in the previous frame, and those
 * in the current frame (next).
+* Both frames use their cached gray plane, so the previous frame is not converted again.
 * 
-* @param (vector<Frame>) _buf: the frame buffer from which the last and second to last frames are extracted
+* @param (Backend) _be: compute backend
+* @param (Frame*) _prev: level of the previous frame, with its gray plane and features (Framecontext::previous);
+*        nullptr for the first frame
+* @param (Frame) _next: the same level of this frame, with its gray plane (Framecontext::gray)
 * @see [theory](https://docs.opencv.org/4.4.0/d4/dee/tutorial_optical_flow.html)
 * @see [cuda demo](https://github1s.com/opencv/opencv/blob/master/samples/gpu/pyrlk_optical_flow.cpp)
 */
-void Frame::computeMotion(const vector<Frame>& _buf, cv::Ptr<cv::cuda::CornersDetector>& _cd, cv::Ptr<cv::cuda::SparsePyrLKOpticalFlow>& _of)
+void Frame::computeMotion(Backend& _be, const Frame* _prev, const Frame& _next)
 {
-	// second to last element: matrix are init at count -1, so skip the first two frames
-	if (_buf.at(_buf.size() -2).count > -1)
-	{
-		// init
-		cv::cuda::GpuMat frame_gray_prev, frame_gray_next;
-		cv::cuda::GpuMat prevPts, nextPts, diffPts, status;
-
-		cv::cuda::cvtColor(_buf.at(_buf.size() -2).frame_gpu, frame_gray_prev, cv::COLOR_BGRA2GRAY, 1);
-		cv::cuda::cvtColor(_buf.back().frame_gpu, frame_gray_next, cv::COLOR_BGRA2GRAY, 1);
-
-		// good features to track
-		_cd->detect(frame_gray_prev, prevPts);		// the third, optional, element is mask: reduce area of interest
-
-		// sparse optical flow
-		_of->calc(frame_gray_prev, frame_gray_next, prevPts, nextPts, status);
-
-		try
-		{
-			// compute amount of shift
-			cv::cuda::subtract(prevPts, nextPts, diffPts);
-			double norm = cv::cuda::norm(diffPts, cv::NORM_L2);
-			this->motion = static_cast<float>(norm * norm);
-		}
-		catch (const exception& msg)
-		{
-			cout << "ERR::" << msg.what() << endl;
-		}
-	}
+	Stagetimer timer(STAGE_MOTION, this->count);
+
+	if (_prev != nullptr)
+		this->motion = _be.motion(*_prev, _next);
 	else
-	{
 		this->motion = 0.0f;
-	}
+}
+
+/**
+* Compute the grayscale plane
+*
+* The plane is computed by the backend on first use and kept with the frame, so that blur
+* and motion (also on the next frame, through the buffer) share a single conversion.
+*
+* @param _be (Backend): compute backend
+*/
+void Frame::computeGray(Backend& _be)
+{
+	if (this->gray_ready)
+		return;
+
+	Stagetimer timer(STAGE_GRAY, this->count);
+#if USE_CUDA
+	const uchar* old_data = this->gray_cpu.empty() ? this->gray_gpu.data : this->gray_cpu.data;
+	_be.gray(*this);
+	const uchar* new_data = this->gray_cpu.empty() ? this->gray_gpu.data : this->gray_cpu.data;
+#else
+	const uchar* old_data = this->gray_cpu.data;
+	_be.gray(*this);
+	const uchar* new_data = this->gray_cpu.data;
+#endif
+
+	this->gray_ready = true;
+	Counters::gray_conversions.fetch_add(1, memory_order_relaxed);
+	if (new_data != old_data)
+		Counters::buffer_allocs.fetch_add(1, memory_order_relaxed);
+}
+
+/**
+* Compute the features to track
+*
+* Detected on the gray plane on first use and kept in the history, where motion reads them
+* when this frame has become the previous one.
+*
+* @param _be (Backend): compute backend
+*/
+void Frame::computeFeatures(Backend& _be, const int& _level)
+{
+	Frame& src = getLevel(_be, _level);
+
+	if (src.pts_ready)
+		return;
+
+	Stagetimer timer(STAGE_FEATURES, src.count);
+	src.computeGray(_be);
+	_be.features(src);
+	src.pts_ready = true;
+}
+
+/**
+* Compute the full histogram of a channel
+*
+* The MAX_BIN_NUMBER histogram is computed by the backend on first use and cached, so
+* exposure and entropy share a single colour conversion.
+*
+* @param _be (Backend): compute backend
+* @param ch_number: (int) the channel of the considered histogram
+*/
+void Frame::computeFullHist(Backend& _be, const int& ch_number)
+{
+	if (this->hist_ch == ch_number)
+		return;
+
+	Stagetimer timer(STAGE_HIST, this->count);
+	this->hist_full = _be.hist(*this, ch_number, MAX_BIN_NUMBER);
+	this->hist_ch = ch_number;
 }
 
 /**
 * Compute histogram of the required number of bins
 *
-* The function computes the histogram for the required number of bins.
-* The matrix must be downloaded to access the values.
+* Derived from the cached full histogram (computeFullHist) by summing bins (see foldHist).
 *
+* @param _be (Backend): compute backend
 * @param ch_number: (int) the channel of the considered histogram
 * @param bin_number: (int) the number of bins of the histogram
-* @param area: (double) the number of pixels in the original matrix (normalization)
+* @return (cv::Mat) bins x 1, CV_32S, owned by the caller
 */
-cv::Mat Frame::computeHist(const int& ch_number, const int& _bin_number)
+cv::Mat Frame::computeHist(Backend& _be, const int& ch_number, const int& _bin_number)
 {
-	// init
-	cv::cuda::GpuMat temp_mat, hsv_mat, v_hist, v_hist_t;
-	cv::Mat hist_cpu;
+	computeFullHist(_be, ch_number);
 
-	// colorspace translation: cuda has not direct transformation rgba -> hsv
-	cv::cuda::cvtColor(this->frame_gpu, temp_mat, cv::COLOR_BGRA2BGR, 3);
-	cv::cuda::cvtColor(temp_mat, hsv_mat, cv::COLOR_BGR2HSV, 3);
+	if (_bin_number == MAX_BIN_NUMBER)
+	{
+		Counters::bytes_copied.fetch_add(this->hist_full.total() * this->hist_full.elemSize(), memory_order_relaxed);
+		return this->hist_full.clone();
+	}
+
+	return Frame::foldHist(this->hist_full, _bin_number);
+}
 
-	// split HSV channels
-	vector<cv::cuda::GpuMat> channels;
-	cv::cuda::split(hsv_mat, channels);
+/**
+* Fold a full histogram into fewer bins
+*
+* Bin i sums the values [i * 256 / bins, (i + 1) * 256 / bins): the integer even levels
+* of cuda::histEven, so a folded histogram equals the one computed directly on the device.
+*
+* @param _hist_full (cv::Mat): MAX_BIN_NUMBER x 1, CV_32S
+* @param bin_number: (int) the number of bins of the output histogram
+* @return (cv::Mat) bins x 1, CV_32S
+*/
+cv::Mat Frame::foldHist(const cv::Mat& _hist_full, const int& _bin_number)
+{
+	cv::Mat hist_cpu = cv::Mat::zeros(_bin_number, 1, CV_32S);
 
-	// compute histogram and download on cpu to further elaboration
-	cv::cuda::histEven(channels[ch_number], v_hist, _bin_number, 0, 256);		// 256(3) for full histogram
-	cv::cuda::transpose(v_hist, v_hist_t);		// cpu and gpu mat are transposed wtf!! // type 4
+	for (int i = 0; i < _bin_number; i++)
+		for (int v = i * MAX_BIN_NUMBER / _bin_number; v < (i + 1) * MAX_BIN_NUMBER / _bin_number; v++)
+			hist_cpu.at<int>(i, 0) += _hist_full.at<int>(v, 0);
 
-	// set
-	v_hist_t.download(hist_cpu);	// download or will not be able to access matrix values wtf pt2 // 3r, 1c
 	return hist_cpu;
 }
 
@@ -213,6 +412,12 @@ int Frame::getFrameCounter() const
 	return this->count;
 }
 
+/// presentation time (ms), -1 if unknown
+double Frame::getTimestamp() const
+{
+	return this->timestamp;
+}
+
 /// blur level
 vector<pair<float, float>> Frame::getBlurLevel() const
 {
@@ -237,8 +442,52 @@ float Frame::getMotionLevel() const
 	return this->motion;
 }
 
+/**
+* Output row of a metric
+*
+* @param _slot (int): index of the metric among the enabled ones
+* @return (vector<float>) the row, empty until the metric computes it
+*/
+vector<float>& Frame::getRow(const int& _slot)
+{
+	if (static_cast<int>(this->rows.size()) <= _slot)
+		this->rows.resize(_slot + 1);
+
+	return this->rows[_slot];
+}
+
+/// cpu frame
+cv::Mat Frame::getCurrentHostMat() const
+{
+	return this->frame_cpu;
+}
+
+/// size of the image, whichever memory holds it
+cv::Size Frame::getImageSize() const
+{
+#if USE_CUDA
+	if (this->frame_cpu.empty())
+		return this->frame_gpu.size();
+#endif
+	return this->frame_cpu.size();
+}
+
+/// address of the decoding buffer, whichever memory holds it (used to count reallocations)
+const uchar* Frame::getImageData() const
+{
+	const cv::Mat& host = this->scaled ? this->native_cpu : this->frame_cpu;
+#if USE_CUDA
+	const cv::cuda::GpuMat& device = this->scaled ? this->native_gpu : this->frame_gpu;
+	if (host.empty())
+		return device.data;
+#endif
+	return host.data;
+}
+
+#if USE_CUDA
 /// gpu frame
 cv::cuda::GpuMat Frame::getCurrentMat() const
 {
 	return this->frame_gpu;
 }
+#endif
@@ -2,51 +2,102 @@
 #define __FRAME_H__
 
 #include "generica.hpp"
+#include "backend.hpp"
+#include "counters.hpp"
+#include "perf.hpp"
 #include <opencv2/core.hpp>
-#include <opencv2/cudacodec.hpp>
 #include <opencv2/highgui.hpp>
-#include <opencv2/cudafilters.hpp>	// sobel
-#include <opencv2/cudaarithm.hpp>	// cuda::norm
-#include <opencv2/cudaimgproc.hpp>	// cuda::cvtcolor
-#include <opencv2/cudaoptflow.hpp>
 #include <opencv2/core/cvstd.hpp>
+#if USE_CUDA
+#include <opencv2/core/cuda.hpp>
+#endif
 
 #define MIN_BIN_NUMBER 5
 #define MAX_BIN_NUMBER 256
+#define V_CHANNEL 2
+
+#define MOTION_HISTORY 1		// past frames read by motion
+
+#define PYRAMID_MIN_SIZE 16		// no pyramid level smaller than this (pixels, either side)
 
 using namespace std;
 
 class Frame
 {
 private:
+	cv::Mat frame_cpu;				// if VideoCapture is used --> BGR (3 channels)
+#if USE_CUDA
 	cv::cuda::GpuMat frame_gpu;		// if cudacoded is used --> BGRA (4 channels)
+#endif
+	cv::Mat native_cpu;				// decoded image, while frame_cpu holds the analysis image (see downscale)
+#if USE_CUDA
+	cv::cuda::GpuMat native_gpu;
+#endif
+	bool scaled;
 	int count;
+	double timestamp;				// presentation time (ms), -1 if the reader does not tell
+	cv::Mat gray_cpu;				// grayscale plane, computed on first use (see computeGray)
+#if USE_CUDA
+	cv::cuda::GpuMat gray_gpu;
+#endif
+	bool gray_ready;
+	vector<cv::Point2f> pts_cpu;	// features to track, detected on the gray plane (see computeFeatures)
+#if USE_CUDA
+	cv::cuda::GpuMat pts_gpu;
+#endif
+	bool pts_ready;
+	cv::Mat hist_full;				// MAX_BIN_NUMBER bins of channel hist_ch, computed once per frame
+	int hist_ch;					// -1 if hist_full is not computed yet
 	vector<pair<float, float>> blur_level;				// [0:inf), [0:2] normalized post acquisition
 	float exposure_level;			// [-1:1]
 	float entropy_level;			// [0:inf)
 	float motion;					// [0:inf)
+	vector<Frame> pyramid;			// level k at [k - 1]: image halved k times, with its own products (see getLevel)
+	int pyramid_ready;				// levels built for the current image
+	vector<vector<float>> rows;		// output row of each enabled metric (see Metric::compute)
 
 public:
 	// Constructors
 	Frame();
-	Frame(cv::cuda::GpuMat& _gpu_mat, int _count);
+
+	// methods::slot recycling
+	void reset(const int& _count);
+	void swapProducts(Frame& _other);
+	size_t getBytes() const;
+	void downscale(Backend& _be, const cv::Size& _size);
+	Frame& getLevel(Backend& _be, const int& _level);
 
 	// methods::setters
-	void computeBlur(cv::Ptr<cv::cuda::Filter>& _lap, const cv::Rect& _roi, const int _patch_info[]);
-	void computeExposure(const int& ch_number, const int& _bin_number, const double& _area);
-	void computeEntropy(const int& ch_number, const int& _bin_number, const double& _area);
-	void computeMotion(const vector<Frame>& _buf, cv::Ptr<cv::cuda::CornersDetector>& _cd, cv::Ptr<cv::cuda::SparsePyrLKOpticalFlow>& _of);
+	void computeBlur(Backend& _be, const Frame& _src, const cv::Rect& _roi, const int _patch_info[]);
+	void computeExposure(const cv::Mat& _hist, const double& _area);
+	void computeEntropy(const cv::Mat& _hist, const double& _area);
+	void computeMotion(Backend& _be, const Frame* _prev, const Frame& _next);
 
 	// methods::getter
 	int getFrameCounter() const;
+	double getTimestamp() const;
 	vector<pair<float, float>> getBlurLevel() const;
 	float getExposureLevel() const;
 	float getEntropyLevel() const;
 	float getMotionLevel() const;
+	vector<float>& getRow(const int& _slot);
+	cv::Mat getCurrentHostMat() const;
+	const uchar* getImageData() const;
+	cv::Size getImageSize() const;
+#if USE_CUDA
 	cv::cuda::GpuMat getCurrentMat() const;
+#endif
 
 	// methods::other
-	cv::Mat computeHist(const int& ch_number, const int& _bin_number);
+	void computeGray(Backend& _be);
+	void computeFeatures(Backend& _be, const int& _level);
+	void computeFullHist(Backend& _be, const int& ch_number);
+	cv::Mat computeHist(Backend& _be, const int& ch_number, const int& _bin_number);
+	static cv::Mat foldHist(const cv::Mat& _hist_full, const int& _bin_number);
+
+	// backends read and write the image storage
+	friend class Cpubackend;
+	friend class Cudabackend;
 };
 
 #endif
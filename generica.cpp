@@ -112,6 +112,124 @@ void Generica::splitPath(const filesystem::path& _path, Tpath& _tpath)
 	_tpath.ext = _path.extension().string();
 }
 
+/**
+* Videos from a path
+*
+* The path may be:
+* - a file: that video
+* - a directory: all the videos in it (by extension, not recursive)
+* - a glob on the file name (e.g. /videos/day1_*.mp4): all the matching files
+* Files are sorted by name. No match is an error.
+*
+* @param _str (string): path from settings
+* @param _tpaths (vector<Tpath>): the videos are appended here
+*/
+void Generica::expandPath(const string& _str, vector<Tpath>& _tpaths)
+{
+	filesystem::path path = filesystem::u8path(_str);
+	string name = path.filename().string();
+	vector<filesystem::path> found;
+
+	if (name.find_first_of("*?") != string::npos)
+	{
+		filesystem::path dir = path.has_parent_path() ? path.parent_path() : filesystem::path(".");
+
+		if (!filesystem::is_directory(dir))
+		{
+			cerr << "ERR::" << dir.string() << " is not a directory. Quitting..." << endl;
+			exit(-1);
+		}
+
+		for (const filesystem::directory_entry& entry : filesystem::directory_iterator(dir))
+			if (entry.is_regular_file() && Generica::wildcardMatch(name, entry.path().filename().string()))
+				found.push_back(entry.path());
+	}
+	else if (filesystem::is_directory(path))
+	{
+		for (const filesystem::directory_entry& entry : filesystem::directory_iterator(path))
+			if (entry.is_regular_file() && Generica::isVideo(entry.path()))
+				found.push_back(entry.path());
+	}
+	else
+	{
+		found.push_back(path);
+	}
+
+	if (found.empty())
+	{
+		cerr << "ERR::no video found in " << _str << ". Quitting..." << endl;
+		exit(-1);
+	}
+
+	sort(found.begin(), found.end());
+
+	for (size_t i = 0; i < found.size(); i++)
+	{
+		Tpath tpath;
+		Generica::splitPath(found[i], tpath);
+		_tpaths.push_back(tpath);
+	}
+}
+
+/**
+* Glob match on a string
+*
+* '*' matches any sequence (also empty), '?' any single character.
+*
+* @param _pattern (string): the pattern
+* @param _str (string): the string to test
+* @return (bool) true if the whole string matches
+*/
+bool Generica::wildcardMatch(const string& _pattern, const string& _str)
+{
+	size_t p = 0, s = 0;
+	size_t star = string::npos, star_s = 0;		// last '*' and where it started matching
+
+	while (s < _str.size())
+	{
+		if (p < _pattern.size() && (_pattern[p] == '?' || _pattern[p] == _str[s]))
+		{
+			p++;
+			s++;
+		}
+		else if (p < _pattern.size() && _pattern[p] == '*')
+		{
+			star = p++;
+			star_s = s;
+		}
+		else if (star != string::npos)
+		{
+			// backtrack: the last '*' takes one more character
+			p = star + 1;
+			s = ++star_s;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	while (p < _pattern.size() && _pattern[p] == '*')
+		p++;
+
+	return p == _pattern.size();
+}
+
+/**
+* Check the extension of a video file (case insensitive)
+*
+* @param _path (filesystem::path): the file
+* @return (bool) true if the extension is in VIDEO_EXTENSIONS
+*/
+bool Generica::isVideo(const filesystem::path& _path)
+{
+	const vector<string> extensions = VIDEO_EXTENSIONS;
+	string ext = _path.extension().string();
+	transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return tolower(c); });
+
+	return find(extensions.begin(), extensions.end(), ext) != extensions.end();
+}
+
 /**
 * Check boolean string
 * 
@@ -149,43 +267,47 @@ bool Generica::str2Bool(const string& _str)
 * Create a csv file for the specified feature
 * 
 * Given the feature you want to track, this function creates a <video_filename>_meta directory
-* that will contain the CSV file.
+* that will contain the CSV file. The first line is the header (analysis scale and pyramid
+* level are in analysis.json, see Videostream::saveAnalysis).
 * 
 * @param (Tpath) path to the input video file
 * @param (string) name of the feature
+* @param (vector<string>) value columns (frame_n excluded), see Metric::getColumns
 * @return (string) path to the new csv file
 */
-string Generica::makeCSV(ofstream& _csv_file, Tpath& _tpath, const string& _feature_name, const int patch_info[])
+string Generica::makeCSV(ofstream& _csv_file, Tpath& _tpath, const string& _feature_name, const vector<string>& _columns)
 {
-	filesystem::path container_dir = filesystem::u8path(_tpath.dirname) / filesystem::u8path(_tpath.filename);
-	container_dir += "_meta";
-
-	filesystem::create_directory(container_dir);
+	filesystem::path container_dir = filesystem::u8path(Generica::makeMetaDir(_tpath));
 	string csv_path = (container_dir / filesystem::u8path(_feature_name) += ".csv").string();
 
-	// write header
+	// write header: delete first, the old file may be a link to the result cache
+	filesystem::remove(filesystem::u8path(csv_path));
 	_csv_file.open(csv_path);
-	
-	if (_feature_name.compare("blur") == 0)
-	{
-		_csv_file << "frame_n";
+	_csv_file << "frame_n";
 
-		for (int y = 0; y < patch_info[1]; y++)
-			for (int x = 0; x < patch_info[0]; x++)
-				_csv_file << ",blur_" + to_string(y) + to_string(x) + ",var_" + to_string(y) + to_string(x);
-		
-		_csv_file << endl;
-	}
-	else
-	{
-		_csv_file << "frame_n," << _feature_name << endl;
-	}
+	for (size_t i = 0; i < _columns.size(); i++)
+		_csv_file << "," << _columns[i];
 
+	_csv_file << endl;
 	_csv_file.close();
 
 	return csv_path;
 }
 
+/**
+* Output directory of a video
+*
+* @param _tpath (Tpath): the video
+* @return (string) <dirname>/<filename>_meta, created if missing
+*/
+string Generica::makeMetaDir(const Tpath& _tpath)
+{
+	filesystem::path container_dir = filesystem::u8path(_tpath.dirname) / filesystem::u8path(_tpath.filename);
+	container_dir += "_meta";
+
+	filesystem::create_directory(container_dir);
+	return container_dir.string();
+}
 
 /**
 * Get width according to original proportion
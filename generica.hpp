@@ -8,10 +8,22 @@
 #include <locale> // string to bool
 #include <filesystem>
 #include <vector>
+#include <map>
+#include <algorithm>
 #include <math.h> // ceil/floor
 
 #define ROI_LEN 4
 #define GRID_EL 2	// n_patch x, n_patch y
+#define PYRAMID_MAX_LEVEL 4		// level k is the analysis image halved k times
+#define OUTPUT_CSV "csv"			// output_format: text CSV (default)
+#define OUTPUT_COLUMNS "columns"	// output_format: binary columns, see Colwriter
+#define OUTPUT_BOTH "both"
+#define SAMPLE_ALL "all"			// sampling: every frame (default)
+#define SAMPLE_STRIDE "stride"		// sampling: every sample_stride-th frame
+#define SAMPLE_FPS "fps"			// sampling: sample_fps frames per second of media time
+#define SAMPLE_RANDOM "random"		// sampling: each frame with probability sample_ratio, seeded by sample_seed
+#define SAMPLE_KEYFRAMES "keyframes"	// sampling: keyframes only, see Keyframereader
+#define VIDEO_EXTENSIONS { ".mp4", ".mov", ".avi", ".mkv", ".m4v", ".mpg", ".mpeg", ".wmv", ".webm", ".mts", ".ts", ".synth" }
 
 using namespace std;
 
@@ -28,9 +40,26 @@ ostream& operator<<(ostream& _os, const Tpath& _tpath);
 
 typedef struct
 {
-	Tpath video_path;
-	bool blur, exposure, entropy, motion;
+	Tpath video_path;			// video being processed (the first one in video_paths)
+	vector<Tpath> video_paths;	// all the videos of the batch
+	string backend;				// auto, cpu, cuda
+	int workers;				// analysis threads, 0 = auto
+	int segments;				// parallel segments of the video, 0 or 1 = whole video
+	string output_format;		// csv, columns, both
+	string cache_dir;			// result cache, empty = disabled
+	string sampling;			// all, stride, fps, random, keyframes
+	int sample_stride;			// stride: keep one frame every sample_stride
+	double sample_fps;			// fps: frames kept per second of media time
+	double sample_ratio;		// random: fraction of frames kept
+	int sample_seed;			// random: seed, same seed = same frames
+	int analysis_height;		// frames are analyzed at this height, 0 = native resolution
+	map<string, int> pyramid_levels;	// pyramid level of each metric, by name; missing ones are 0
+	map<string, bool> metrics;	// enabled metrics, by name (see Metricregistry)
 	bool debug, show;			// debug print stdout stderr, show video
+	bool resume;				// continue an interrupted run from its checkpoint
+	bool trace;					// write a Chrome trace of the stages (trace.json)
+	bool counters;				// hardware counters of the Frame stages in perf.json (Linux)
+	int progress;				// seconds between progress updates (status.json), 0 = off
 	vector<int> blur_roi;		// (4) x,y,w,h
 	vector<int> patch_grid;		// (2) n_patch x, n_patch y
 }Targuments;
@@ -47,22 +76,13 @@ public:
 	static bool pathIsFile(const filesystem::path& _path);
 	static bool intToBool(const int& _val);
 	static void splitPath(const filesystem::path& _path, Tpath& _tpath);
+	static void expandPath(const string& _str, vector<Tpath>& _tpaths);
+	static bool wildcardMatch(const string& _pattern, const string& _str);
+	static bool isVideo(const filesystem::path& _path);
 	static bool str2Bool(const string& _str);
-	static string makeCSV(ofstream& _csv_file, Tpath& _tpath, const string& _feature_name, const int patch_info[]=nullptr);
+	static string makeCSV(ofstream& _csv_file, Tpath& _tpath, const string& _feature_name, const vector<string>& _columns);
+	static string makeMetaDir(const Tpath& _tpath);
 	static int getNewW(const double& _old_w, const double& _old_h, const int& _new_h);
-	
-	/** 
-	* Template methods must be in the header
-	* 
-	* @see [SO_1](https://stackoverflow.com/a/972197)
-	* @see [SO_2](https://stackoverflow.com/questions/495021/why-can-templates-only-be-implemented-in-the-header-file)
-	*/
-	template <typename T>
-	static void bufferize(vector<T>& t_vec, T& _elem)
-	{
-		t_vec.erase(t_vec.begin());
-		t_vec.push_back(_elem);
-	}
 };
 
 #endif
@@ -0,0 +1,408 @@
+#include "kernels.hpp"
+#include <algorithm>	// max
+#include <vector>
+
+using namespace std;
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define KERNELS_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define KERNELS_SSE2 1
+#endif
+
+/// 3x3 Laplacian [2 0 2; 0 -8 0; 2 0 2] at column x, saturated to [0, 255] like a CV_8U filter output
+static inline int lapAt(const uint8_t* _up, const uint8_t* _cur, const uint8_t* _dn, const int& _x, const int& _l, const int& _r)
+{
+	int v = 2 * (_up[_l] + _up[_r] + _dn[_l] + _dn[_r]) - 8 * _cur[_x];
+	return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+#if defined(KERNELS_AVX2) || defined(KERNELS_SSE2)
+/// sum of the 32 bit lanes
+static inline uint64_t hsum32(const __m128i& _v)
+{
+	alignas(16) int32_t lanes[4];
+	_mm_store_si128(reinterpret_cast<__m128i*>(lanes), _v);
+	return static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+#endif
+
+/**
+* One row of one patch
+*
+* Pixel and Laplacian sums for the columns [0, _pw) of a patch row. The patch is isolated:
+* its first and last columns are reflected (BORDER_REFLECT_101), as for the rows.
+* Interior columns are vectorized; the 16 bit lanes cannot overflow (|lap| <= 2040) and
+* the 32 bit accumulators are emptied at the end of every row.
+*
+* @param _up, _cur, _dn (uint8_t*): previous, current and next row, already reflected
+* @param _pw (int): patch width
+* @param _stats (Tblurstats): accumulators of the patch
+*/
+static void blurPatchRow(const uint8_t* _up, const uint8_t* _cur, const uint8_t* _dn, const int& _pw, Tblurstats& _stats)
+{
+	uint64_t pix_sum = 0, pix_sqsum = 0, lap_sum = 0, lap_sqsum = 0;
+	int x = 1;
+
+#if defined(KERNELS_AVX2)
+	const __m256i zero = _mm256_setzero_si256(), ones = _mm256_set1_epi16(1), max8 = _mm256_set1_epi16(255);
+	__m256i acc_ps = zero, acc_pq = zero, acc_ls = zero, acc_lq = zero;
+
+	for (; x + 16 <= _pw - 1; x += 16)
+	{
+		__m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_up + x - 1)));
+		__m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_up + x + 1)));
+		__m256i c = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_dn + x - 1)));
+		__m256i d = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_dn + x + 1)));
+		__m256i e = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_cur + x)));
+
+		__m256i lap = _mm256_sub_epi16(_mm256_slli_epi16(_mm256_add_epi16(_mm256_add_epi16(a, b), _mm256_add_epi16(c, d)), 1), _mm256_slli_epi16(e, 3));
+		lap = _mm256_min_epi16(_mm256_max_epi16(lap, zero), max8);
+
+		acc_ps = _mm256_add_epi32(acc_ps, _mm256_madd_epi16(e, ones));
+		acc_pq = _mm256_add_epi32(acc_pq, _mm256_madd_epi16(e, e));
+		acc_ls = _mm256_add_epi32(acc_ls, _mm256_madd_epi16(lap, ones));
+		acc_lq = _mm256_add_epi32(acc_lq, _mm256_madd_epi16(lap, lap));
+	}
+
+	pix_sum += hsum32(_mm_add_epi32(_mm256_castsi256_si128(acc_ps), _mm256_extracti128_si256(acc_ps, 1)));
+	pix_sqsum += hsum32(_mm_add_epi32(_mm256_castsi256_si128(acc_pq), _mm256_extracti128_si256(acc_pq, 1)));
+	lap_sum += hsum32(_mm_add_epi32(_mm256_castsi256_si128(acc_ls), _mm256_extracti128_si256(acc_ls, 1)));
+	lap_sqsum += hsum32(_mm_add_epi32(_mm256_castsi256_si128(acc_lq), _mm256_extracti128_si256(acc_lq, 1)));
+#elif defined(KERNELS_SSE2)
+	const __m128i zero = _mm_setzero_si128(), ones = _mm_set1_epi16(1), max8 = _mm_set1_epi16(255);
+	__m128i acc_ps = zero, acc_pq = zero, acc_ls = zero, acc_lq = zero;
+
+	for (; x + 8 <= _pw - 1; x += 8)
+	{
+		__m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(_up + x - 1)), zero);
+		__m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(_up + x + 1)), zero);
+		__m128i c = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(_dn + x - 1)), zero);
+		__m128i d = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(_dn + x + 1)), zero);
+		__m128i e = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(_cur + x)), zero);
+
+		__m128i lap = _mm_sub_epi16(_mm_slli_epi16(_mm_add_epi16(_mm_add_epi16(a, b), _mm_add_epi16(c, d)), 1), _mm_slli_epi16(e, 3));
+		lap = _mm_min_epi16(_mm_max_epi16(lap, zero), max8);
+
+		acc_ps = _mm_add_epi32(acc_ps, _mm_madd_epi16(e, ones));
+		acc_pq = _mm_add_epi32(acc_pq, _mm_madd_epi16(e, e));
+		acc_ls = _mm_add_epi32(acc_ls, _mm_madd_epi16(lap, ones));
+		acc_lq = _mm_add_epi32(acc_lq, _mm_madd_epi16(lap, lap));
+	}
+
+	pix_sum += hsum32(acc_ps);
+	pix_sqsum += hsum32(acc_pq);
+	lap_sum += hsum32(acc_ls);
+	lap_sqsum += hsum32(acc_lq);
+#endif
+
+	// scalar tail of the interior
+	for (; x < _pw - 1; x++)
+	{
+		int v = _cur[x];
+		int l = lapAt(_up, _cur, _dn, x, x - 1, x + 1);
+		pix_sum += v;
+		pix_sqsum += v * v;
+		lap_sum += l;
+		lap_sqsum += l * l;
+	}
+
+	// first and last column: reflected neighbours (a single column reflects on itself)
+	int last = _pw > 1 ? _pw - 1 : 0;
+	for (int i = 0; i < (_pw > 1 ? 2 : 1); i++)
+	{
+		int xx = i == 0 ? 0 : last;
+		int nb = _pw > 1 ? (i == 0 ? 1 : _pw - 2) : 0;
+		int v = _cur[xx];
+		int l = lapAt(_up, _cur, _dn, xx, nb, nb);
+		pix_sum += v;
+		pix_sqsum += v * v;
+		lap_sum += l;
+		lap_sqsum += l * l;
+	}
+
+	_stats.pix_sum += pix_sum;
+	_stats.pix_sqsum += pix_sqsum;
+	_stats.lap_sum += lap_sum;
+	_stats.lap_sqsum += lap_sqsum;
+}
+
+/**
+* Fused blur accumulation over a band of rows
+*
+* Each grayscale row is read once and feeds both the pixel and the Laplacian accumulators
+* of all the patches it crosses. Rows are relative to the ROI origin (_data) and the bands
+* can be processed in parallel as long as every band writes to its own _stats.
+*
+* @param _data (uint8_t*): ROI origin of the grayscale image
+* @param _step (size_t): bytes per image row
+* @param _patch_info (int*): nx, ny, patch w, patch h
+* @param _row_begin, _row_end (int): rows [begin, end) of the band
+* @param _stats (Tblurstats*): nx * ny accumulators, row-major
+*/
+void Kernels::blurRows(const uint8_t* _data, const size_t& _step, const int _patch_info[], const int& _row_begin, const int& _row_end, Tblurstats* _stats)
+{
+	const int nx = _patch_info[0], ny = _patch_info[1], pw = _patch_info[2], ph = _patch_info[3];
+
+	for (int r = _row_begin; r < _row_end; r++)
+	{
+		int py = r / ph;
+		if (py >= ny)
+			break;
+
+		// patch-local row reflection (BORDER_REFLECT_101)
+		int ly = r - py * ph;
+		int up_y = ly > 0 ? ly - 1 : (ph > 1 ? 1 : 0);
+		int dn_y = ly < ph - 1 ? ly + 1 : (ph > 1 ? ph - 2 : 0);
+
+		const uint8_t* up = _data + (py * ph + up_y) * _step;
+		const uint8_t* cur = _data + r * _step;
+		const uint8_t* dn = _data + (py * ph + dn_y) * _step;
+
+		for (int px = 0; px < nx; px++)
+			blurPatchRow(up + px * pw, cur + px * pw, dn + px * pw, pw, _stats[py * nx + px]);
+	}
+}
+
+/**
+* Variances from the accumulators
+*
+* Population variances, as cv::meanStdDev. The sums are exact integers, so the only
+* rounding happens here, in double.
+*
+* @param _stats (Tblurstats): accumulators of one patch
+* @param _n (int): number of pixels of the patch
+* @param _var_blur (float): variance of the Laplacian
+* @param _var_pixel (float): variance of the pixels
+*/
+void Kernels::blurVariance(const Tblurstats& _stats, const int& _n, float& _var_blur, float& _var_pixel)
+{
+	double n = static_cast<double>(_n);
+	double mean_pix = static_cast<double>(_stats.pix_sum) / n;
+	double mean_lap = static_cast<double>(_stats.lap_sum) / n;
+
+	_var_pixel = static_cast<float>(static_cast<double>(_stats.pix_sqsum) / n - mean_pix * mean_pix);
+	_var_blur = static_cast<float>(static_cast<double>(_stats.lap_sqsum) / n - mean_lap * mean_lap);
+}
+
+/**
+* V channel histogram over a band of rows
+*
+* V of HSV is max(B, G, R), so the histogram is binned straight from the packed BGR(A)
+* pixels, without the HSV image and the channel split. Four private sub-histograms are
+* filled in turn, so that equal consecutive values do not wait on the same counter.
+* For BGRA rows the per-pixel max is vectorized (alpha is masked out).
+*
+* @param _data (uint8_t*): first row of the image
+* @param _step (size_t): bytes per image row
+* @param _cols (int): pixels per row
+* @param _cn (int): channels, 3 (BGR) or 4 (BGRA)
+* @param _row_begin, _row_end (int): rows [begin, end) of the band
+* @param _hist (uint32_t[256]): output, added to
+*/
+void Kernels::histVRows(const uint8_t* _data, const size_t& _step, const int& _cols, const int& _cn, const int& _row_begin, const int& _row_end, uint32_t _hist[256])
+{
+	uint32_t sub[4][256] = { { 0 } };
+
+	for (int r = _row_begin; r < _row_end; r++)
+	{
+		const uint8_t* row = _data + r * _step;
+		int x = 0;
+
+		if (_cn == 4)
+		{
+#if defined(KERNELS_AVX2) || defined(KERNELS_SSE2)
+			const __m128i rgb = _mm_set1_epi32(0x00FFFFFF);
+			alignas(16) uint8_t v[16];
+
+			for (; x + 4 <= _cols; x += 4)
+			{
+				__m128i p = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 4 * x)), rgb);
+				p = _mm_max_epu8(p, _mm_srli_epi32(p, 8));		// byte 0: max(B, G)
+				p = _mm_max_epu8(p, _mm_srli_epi32(p, 16));		// byte 0: max(B, G, R)
+				_mm_store_si128(reinterpret_cast<__m128i*>(v), p);
+
+				sub[0][v[0]]++;
+				sub[1][v[4]]++;
+				sub[2][v[8]]++;
+				sub[3][v[12]]++;
+			}
+#else
+			for (; x + 4 <= _cols; x += 4)
+			{
+				const uint8_t* p = row + 4 * x;
+				sub[0][max(p[0], max(p[1], p[2]))]++;
+				sub[1][max(p[4], max(p[5], p[6]))]++;
+				sub[2][max(p[8], max(p[9], p[10]))]++;
+				sub[3][max(p[12], max(p[13], p[14]))]++;
+			}
+#endif
+		}
+		else
+		{
+			for (; x + 4 <= _cols; x += 4)
+			{
+				const uint8_t* p = row + _cn * x;
+				sub[0][max(p[0], max(p[1], p[2]))]++;
+				sub[1][max(p[_cn], max(p[_cn + 1], p[_cn + 2]))]++;
+				sub[2][max(p[2 * _cn], max(p[2 * _cn + 1], p[2 * _cn + 2]))]++;
+				sub[3][max(p[3 * _cn], max(p[3 * _cn + 1], p[3 * _cn + 2]))]++;
+			}
+		}
+
+		for (; x < _cols; x++)
+		{
+			const uint8_t* p = row + _cn * x;
+			sub[0][max(p[0], max(p[1], p[2]))]++;
+		}
+	}
+
+	for (int i = 0; i < 256; i++)
+		_hist[i] += sub[0][i] + sub[1][i] + sub[2][i] + sub[3][i];
+}
+
+#if defined(KERNELS_AVX2) || defined(KERNELS_SSE2)
+/// 16 bit lanes: [a.lo + a.hi | b.lo + b.hi], i.e. the sum of two adjacent BGRA pixels of a and of b
+static inline __m128i pairSum(const __m128i& _a, const __m128i& _b)
+{
+	return _mm_add_epi16(_mm_unpacklo_epi64(_a, _b), _mm_unpackhi_epi64(_a, _b));
+}
+#endif
+
+/**
+* Rounded mean of a box, as cv::INTER_AREA: (s + 2) >> 2 for 2x (integer fast path), s / 16
+* rounded half to even for 4x (float scale and cvRound)
+*
+* @param _s (int): sum of the box
+* @param _factor (int): 2 or 4
+* @return (int) the mean
+*/
+static inline int boxMean(const int& _s, const int& _factor)
+{
+	if (_factor == 2)
+		return (_s + 2) >> 2;
+
+	return (_s + 7 + ((_s >> 4) & 1)) >> 4;
+}
+
+/**
+* Box downscale by 2 or 4 over a band of output rows
+*
+* Each output pixel is the rounded mean of a _factor x _factor block of the source, equal to
+* cv::INTER_AREA for integer ratios (boxMean; tools/kernelcheck.cpp compares the two). The
+* _factor source rows are summed in 16 bit lanes (at most 16 * 255, no overflow), then the
+* blocks are summed along the row: vectorized for BGRA, scalar otherwise.
+*
+* @param _src (uint8_t*): first row of the source image
+* @param _src_step (size_t): bytes per source row
+* @param _dst (uint8_t*): first row of the output image
+* @param _dst_step (size_t): bytes per output row
+* @param _dst_cols (int): output pixels per row (source columns / _factor)
+* @param _cn (int): channels
+* @param _factor (int): 2 or 4
+* @param _row_begin, _row_end (int): output rows [begin, end) of the band
+*/
+void Kernels::boxDownRows(const uint8_t* _src, const size_t& _src_step, uint8_t* _dst, const size_t& _dst_step, const int& _dst_cols, const int& _cn, const int& _factor, const int& _row_begin, const int& _row_end)
+{
+	const int src_bytes = _dst_cols * _factor * _cn;
+	vector<uint16_t> sums(src_bytes);
+
+	for (int r = _row_begin; r < _row_end; r++)
+	{
+		const uint8_t* src = _src + static_cast<size_t>(r) * _factor * _src_step;
+		uint8_t* dst = _dst + static_cast<size_t>(r) * _dst_step;
+		uint16_t* sum = sums.data();
+		int x = 0;
+
+		// vertical: sum of the source rows of the block
+#if defined(KERNELS_AVX2)
+		for (; x + 16 <= src_bytes; x += 16)
+		{
+			__m256i acc = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x)));
+			for (int k = 1; k < _factor; k++)
+				acc = _mm256_add_epi16(acc, _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + k * _src_step + x))));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(sum + x), acc);
+		}
+#elif defined(KERNELS_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		for (; x + 8 <= src_bytes; x += 8)
+		{
+			__m128i acc = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + x)), zero);
+			for (int k = 1; k < _factor; k++)
+				acc = _mm_add_epi16(acc, _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + k * _src_step + x)), zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(sum + x), acc);
+		}
+#endif
+		for (; x < src_bytes; x++)
+		{
+			int s = 0;
+			for (int k = 0; k < _factor; k++)
+				s += src[k * _src_step + x];
+			sum[x] = static_cast<uint16_t>(s);
+		}
+
+		// horizontal: sum of the pixels of the block, 4 BGRA output pixels at a time
+		x = 0;
+#if defined(KERNELS_AVX2) || defined(KERNELS_SSE2)
+		if (_cn == 4)
+		{
+			const __m128i one = _mm_set1_epi16(1);
+			const __m128i* in = reinterpret_cast<const __m128i*>(sum);
+
+			for (; x + 4 <= _dst_cols; x += 4)
+			{
+				__m128i lo, hi;		// output pixels 0-1 and 2-3
+
+				if (_factor == 2)
+				{
+					lo = pairSum(_mm_loadu_si128(in + x), _mm_loadu_si128(in + x + 1));
+					hi = pairSum(_mm_loadu_si128(in + x + 2), _mm_loadu_si128(in + x + 3));
+				}
+				else
+				{
+					const __m128i* p = in + 2 * x;
+					lo = pairSum(pairSum(_mm_loadu_si128(p), _mm_loadu_si128(p + 1)), pairSum(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3)));
+					hi = pairSum(pairSum(_mm_loadu_si128(p + 4), _mm_loadu_si128(p + 5)), pairSum(_mm_loadu_si128(p + 6), _mm_loadu_si128(p + 7)));
+				}
+
+				// boxMean
+				if (_factor == 2)
+				{
+					lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_set1_epi16(2)), 2);
+					hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_set1_epi16(2)), 2);
+				}
+				else
+				{
+					lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_add_epi16(_mm_set1_epi16(7), _mm_and_si128(_mm_srli_epi16(lo, 4), one))), 4);
+					hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_add_epi16(_mm_set1_epi16(7), _mm_and_si128(_mm_srli_epi16(hi, 4), one))), 4);
+				}
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x), _mm_packus_epi16(lo, hi));
+			}
+		}
+#endif
+		for (; x < _dst_cols; x++)
+		{
+			for (int c = 0; c < _cn; c++)
+			{
+				int s = 0;
+				for (int k = 0; k < _factor; k++)
+					s += sum[(x * _factor + k) * _cn + c];
+				dst[x * _cn + c] = static_cast<uint8_t>(boxMean(s, _factor));
+			}
+		}
+	}
+}
+
+/// SIMD flavour compiled in, for debug output
+const char* Kernels::simdName()
+{
+#if defined(KERNELS_AVX2)
+	return "avx2";
+#elif defined(KERNELS_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
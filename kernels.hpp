@@ -0,0 +1,32 @@
+#ifndef __KERNELS_H__
+#define __KERNELS_H__
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+* Host kernels
+*
+* Plain pointer + step kernels used by the cpu backend. They do not depend on OpenCV, so
+* the caller decides how to split the work (cv::parallel_for_ over row bands).
+* x86 builds use AVX2 if enabled at compile time (-mavx2, /arch:AVX2), SSE2 otherwise.
+*/
+
+// exact integer accumulators of one blur patch
+typedef struct
+{
+	uint64_t pix_sum, pix_sqsum;		// gray values
+	uint64_t lap_sum, lap_sqsum;		// 3x3 Laplacian, saturated to 8 bit
+}Tblurstats;
+
+class Kernels
+{
+public:
+	static void blurRows(const uint8_t* _data, const size_t& _step, const int _patch_info[], const int& _row_begin, const int& _row_end, Tblurstats* _stats);
+	static void blurVariance(const Tblurstats& _stats, const int& _n, float& _var_blur, float& _var_pixel);
+	static void histVRows(const uint8_t* _data, const size_t& _step, const int& _cols, const int& _cn, const int& _row_begin, const int& _row_end, uint32_t _hist[256]);
+	static void boxDownRows(const uint8_t* _src, const size_t& _src_step, uint8_t* _dst, const size_t& _dst_step, const int& _dst_cols, const int& _cn, const int& _factor, const int& _row_begin, const int& _row_end);
+	static const char* simdName();
+};
+
+#endif
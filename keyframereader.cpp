@@ -0,0 +1,293 @@
+#include "keyframereader.hpp"
+
+#if USE_LIBAV
+
+Keyframereader::Keyframereader()
+{
+	this->format_ctx = nullptr;
+	this->codec_ctx = nullptr;
+	this->sws_ctx = nullptr;
+	this->packet = nullptr;
+	this->picture = nullptr;
+	this->stream = -1;
+	this->packet_n = 0;
+	this->first_frame = 0;
+	this->draining = false;
+}
+
+Keyframereader::~Keyframereader()
+{
+	release();
+}
+
+/**
+* Open the video and its decoder
+*
+* @param _filename (string): full path to the video
+* @return (bool) false if the video or its decoder cannot be opened
+*/
+bool Keyframereader::open(const string& _filename)
+{
+	release();
+	this->filename = _filename;
+
+	if (avformat_open_input(&this->format_ctx, _filename.c_str(), nullptr, nullptr) < 0)
+		return false;
+
+	if (avformat_find_stream_info(this->format_ctx, nullptr) < 0)
+	{
+		release();
+		return false;
+	}
+
+	for (unsigned i = 0; i < this->format_ctx->nb_streams && this->stream < 0; i++)
+		if (this->format_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+			this->stream = static_cast<int>(i);
+
+	if (this->stream < 0)
+	{
+		release();
+		return false;
+	}
+
+	const AVCodec* codec = avcodec_find_decoder(this->format_ctx->streams[this->stream]->codecpar->codec_id);
+	this->codec_ctx = codec != nullptr ? avcodec_alloc_context3(codec) : nullptr;
+
+	if (this->codec_ctx == nullptr || avcodec_parameters_to_context(this->codec_ctx, this->format_ctx->streams[this->stream]->codecpar) < 0)
+	{
+		release();
+		return false;
+	}
+
+	this->codec_ctx->skip_frame = AVDISCARD_NONKEY;
+	this->codec_ctx->thread_count = 0;		// auto
+
+	if (avcodec_open2(this->codec_ctx, codec, nullptr) < 0)
+	{
+		release();
+		return false;
+	}
+
+	this->packet = av_packet_alloc();
+	this->picture = av_frame_alloc();
+	this->packet_n = 0;
+	this->first_frame = 0;
+	this->draining = false;
+	this->pending.clear();
+
+	return true;
+}
+
+/**
+* Presentation index of a timestamp
+*
+* @param _ts (int64_t): timestamp in the time base of the stream
+* @return (int) frame number, -1 if the timestamp or the frame rate is unknown
+*/
+int Keyframereader::toFrame(int64_t _ts) const
+{
+	const AVStream* st = this->format_ctx->streams[this->stream];
+	AVRational rate = st->avg_frame_rate.num > 0 ? st->avg_frame_rate : st->r_frame_rate;
+
+	if (_ts == AV_NOPTS_VALUE || rate.num <= 0 || rate.den <= 0)
+		return -1;
+
+	if (st->start_time != AV_NOPTS_VALUE)
+		_ts -= st->start_time;
+
+	return static_cast<int>(llround(static_cast<double>(_ts) * av_q2d(st->time_base) * av_q2d(rate)));
+}
+
+/**
+* Frame number of the packet just read
+*
+* @return (int) presentation index, -1 if it cannot be told (no pts and frames are reordered)
+*/
+int Keyframereader::packetFrame() const
+{
+	int frame_n = toFrame(this->packet->pts);
+
+	if (frame_n < 0 && this->format_ctx->streams[this->stream]->codecpar->video_delay == 0)
+		frame_n = this->packet_n;		// decode order is presentation order
+
+	return frame_n;
+}
+
+/**
+* Read the next packet of the video stream
+*
+* Keyframe packets go to the decoder, the others are dropped.
+*
+* @return (bool) false at the end of the file
+*/
+bool Keyframereader::readPacket()
+{
+	while (av_read_frame(this->format_ctx, this->packet) >= 0)
+	{
+		if (this->packet->stream_index != this->stream)
+		{
+			av_packet_unref(this->packet);
+			continue;
+		}
+
+		int frame_n = packetFrame();
+		this->packet_n += 1;
+
+		if ((this->packet->flags & AV_PKT_FLAG_KEY) && frame_n >= this->first_frame)
+		{
+			this->pending.push_back(pair<int64_t, int>(this->packet->pts, frame_n));
+			avcodec_send_packet(this->codec_ctx, this->packet);
+		}
+
+		av_packet_unref(this->packet);
+		return true;
+	}
+
+	return false;
+}
+
+/**
+* Decode the next keyframe
+*
+* @param _bgr (cv::Mat): output image, BGR (as cv::VideoCapture)
+* @param _frame_n (int): frame number of the keyframe
+* @param _pts_ms (double): presentation time in milliseconds from the start of the stream, -1 if unknown
+* @return (bool) false at the end of the video
+*/
+bool Keyframereader::read(cv::Mat& _bgr, int& _frame_n, double& _pts_ms)
+{
+	if (this->codec_ctx == nullptr)
+		return false;
+
+	while (avcodec_receive_frame(this->codec_ctx, this->picture) != 0)
+	{
+		if (this->draining)
+			return false;
+
+		if (!readPacket())
+		{
+			avcodec_send_packet(this->codec_ctx, nullptr);		// flush
+			this->draining = true;
+		}
+	}
+
+	// frame number: the packet with the same pts, else from the timestamp, else the oldest packet
+	vector<pair<int64_t, int>>::iterator it = this->pending.begin();
+	while (it != this->pending.end() && it->first != this->picture->pts)
+		it++;
+
+	_frame_n = it != this->pending.end() ? it->second : toFrame(this->picture->best_effort_timestamp);
+	if (it == this->pending.end())
+		it = this->pending.begin();
+	if (_frame_n < 0)
+		_frame_n = it != this->pending.end() ? it->second : this->packet_n - 1;
+	if (it != this->pending.end())
+		this->pending.erase(it);
+
+	// presentation time
+	const AVStream* st = this->format_ctx->streams[this->stream];
+	int64_t ts = this->picture->best_effort_timestamp;
+	_pts_ms = -1.0;
+	if (ts != AV_NOPTS_VALUE)
+	{
+		if (st->start_time != AV_NOPTS_VALUE)
+			ts -= st->start_time;
+		_pts_ms = static_cast<double>(ts) * av_q2d(st->time_base) * 1000.0;
+	}
+
+	// to BGR, in place if the size does not change
+	const int w = this->picture->width, h = this->picture->height;
+	this->sws_ctx = sws_getCachedContext(this->sws_ctx, w, h, static_cast<AVPixelFormat>(this->picture->format),
+		w, h, AV_PIX_FMT_BGR24, SWS_BILINEAR, nullptr, nullptr, nullptr);
+	_bgr.create(h, w, CV_8UC3);
+
+	uint8_t* dst[] = { _bgr.data };
+	int dst_stride[] = { static_cast<int>(_bgr.step[0]) };
+	sws_scale(this->sws_ctx, this->picture->data, this->picture->linesize, 0, h, dst, dst_stride);
+	av_frame_unref(this->picture);
+
+	return true;
+}
+
+/**
+* Move the reader so that read() returns the first keyframe at or after _frame_n
+*
+* The video is reopened and the keyframe packets before _frame_n are dropped (read, not decoded).
+*
+* @param _frame_n (int): frame index
+* @return (bool) false if the video cannot be reopened
+*/
+bool Keyframereader::seek(const int& _frame_n)
+{
+	if (!open(this->filename))
+		return false;
+
+	this->first_frame = _frame_n;
+	return true;
+}
+
+void Keyframereader::release()
+{
+	if (this->picture != nullptr)
+		av_frame_free(&this->picture);
+	if (this->packet != nullptr)
+		av_packet_free(&this->packet);
+	if (this->codec_ctx != nullptr)
+		avcodec_free_context(&this->codec_ctx);
+	if (this->format_ctx != nullptr)
+		avformat_close_input(&this->format_ctx);
+	if (this->sws_ctx != nullptr)
+	{
+		sws_freeContext(this->sws_ctx);
+		this->sws_ctx = nullptr;
+	}
+
+	this->stream = -1;
+	this->pending.clear();
+}
+
+/**
+* Keyframe indices of a video
+*
+* Reads the packets of the video stream without decoding them.
+*
+* @param _filename (string): full path to the video
+* @return (vector<int>) sorted presentation indices of the keyframes; empty if the video cannot
+*         be opened or a keyframe cannot be numbered (no pts, reordered frames)
+*/
+vector<int> Keyframereader::listKeyframes(const string& _filename)
+{
+	Keyframereader reader;
+	vector<int> keyframes;
+
+	if (!reader.open(_filename))
+		return keyframes;
+
+	while (av_read_frame(reader.format_ctx, reader.packet) >= 0)
+	{
+		if (reader.packet->stream_index == reader.stream)
+		{
+			int frame_n = reader.packetFrame();
+			reader.packet_n += 1;
+
+			if (reader.packet->flags & AV_PKT_FLAG_KEY)
+			{
+				if (frame_n < 0)
+				{
+					av_packet_unref(reader.packet);
+					return vector<int>();
+				}
+				keyframes.push_back(frame_n);
+			}
+		}
+
+		av_packet_unref(reader.packet);
+	}
+
+	sort(keyframes.begin(), keyframes.end());
+	keyframes.erase(unique(keyframes.begin(), keyframes.end()), keyframes.end());
+
+	return keyframes;
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef __KEYFRAMEREADER_H__
+#define __KEYFRAMEREADER_H__
+
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/**
+* Build-time libav detection
+*
+* USE_LIBAV is 1 when the FFmpeg headers are found (link avformat, avcodec, swscale, avutil).
+* Define USE_LIBAV=0 to build without them: keyframes cannot be listed, keyframe sampling then
+* analyzes every frame.
+*/
+#ifndef USE_LIBAV
+	#if __has_include(<libavformat/avformat.h>) && __has_include(<libavcodec/avcodec.h>) && __has_include(<libswscale/swscale.h>)
+		#define USE_LIBAV 1
+	#else
+		#define USE_LIBAV 0
+	#endif
+#endif
+
+#if USE_LIBAV
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+using namespace std;
+
+/**
+* Keyframe-only video reader
+*
+* Reads the packets of the video stream and sends only the keyframe packets to the decoder
+* (which also discards non-key frames), so the inter frames are neither decoded nor converted.
+* Frames are numbered in presentation order, from their pts and the frame rate of the stream,
+* as cv::VideoCapture numbers the decoded frames: packet (decode) order differs with B-frames
+* and open GOPs. Without pts, packets are counted if the stream has no reordering.
+*/
+class Keyframereader
+{
+private:
+	string filename;
+	AVFormatContext* format_ctx;
+	AVCodecContext* codec_ctx;
+	SwsContext* sws_ctx;
+	AVPacket* packet;
+	AVFrame* picture;
+	int stream;
+	int packet_n;							// index of the next packet of the stream
+	int first_frame;						// keyframes before this one are dropped (seek)
+	bool draining;							// end of file: decoder flushed
+	vector<pair<int64_t, int>> pending;		// (pts, frame number) of the packets sent to the decoder
+
+	bool readPacket();
+	int toFrame(int64_t _ts) const;
+	int packetFrame() const;
+
+public:
+	// Constructors
+	Keyframereader();
+	~Keyframereader();
+
+	Keyframereader(const Keyframereader&) = delete;
+	Keyframereader& operator=(const Keyframereader&) = delete;
+
+	// methods
+	bool open(const string& _filename);
+	bool read(cv::Mat& _bgr, int& _frame_n, double& _pts_ms);
+	bool seek(const int& _frame_n);
+	void release();
+	static vector<int> listKeyframes(const string& _filename);
+};
+
+#endif
+
+#endif
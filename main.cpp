@@ -7,6 +7,7 @@
 #include <chrono>
 
 #include "videostream.hpp"
+#include "batch.hpp"
 #include "parser.hpp"
 
 using namespace std;
@@ -47,11 +48,20 @@ int main(int argc, char* argv[])
     // video processing
     auto start_time = chrono::high_resolution_clock::now();
     
-    Videostream vs = Videostream(args.video_path);
-    vs.processing(args);
+    if (args.video_paths.size() > 1)
+    {
+        Batch batch = Batch(args);
+        batch.run();
+        batch.printSummary(cout);
+    }
+    else
+    {
+        Videostream vs = Videostream(args.video_path);
+        vs.processing(args);
+    }
 
     auto stop_time = chrono::high_resolution_clock::now();
-    auto exec_time = chrono::duration_cast<chrono::seconds>(stop_time - start_time);
+    auto exec_time = chrono::duration<double>(stop_time - start_time);
     cout << endl << "DEBUG::time = " << exec_time.count() << " seconds" << endl;
 
     // EOP
@@ -0,0 +1,243 @@
+#include "metric.hpp"
+#include "builtinmetrics.hpp"
+
+Framecontext::Framecontext(Backend& _be, Frame& _frame, const vector<int>& _plan, Ringbuffer<Frame>* _history) : be(_be), frame(_frame), plan(_plan)
+{
+	this->history = _history;
+}
+
+/**
+* Products of the metrics at each pyramid level
+*
+* @param _metrics (vector<cv::Ptr<Metric>>): the enabled metrics, configured
+* @param _temporal_only (bool): only the metrics that read past frames (seed frames)
+* @return (vector<int>) PRODUCT_* of each level, 0 to PYRAMID_MAX_LEVEL
+*/
+vector<int> Framecontext::makePlan(const vector<cv::Ptr<Metric>>& _metrics, const bool& _temporal_only)
+{
+	vector<int> plan(PYRAMID_MAX_LEVEL + 1, 0);
+
+	for (size_t i = 0; i < _metrics.size(); i++)
+		if (!_temporal_only || _metrics[i]->isTemporal())
+			plan[_metrics[i]->getSetup().level] |= _metrics[i]->getProducts();
+
+	return plan;
+}
+
+/**
+* Build the products of the plan on the frame
+*
+* Runs before the metrics, in the workers (also on seed frames). Each product is cached by
+* the frame; PRODUCT_PREVIOUS builds nothing here.
+*/
+void Framecontext::build()
+{
+	for (int l = 0; l < static_cast<int>(this->plan.size()); l++)
+	{
+		const int products = this->plan[l];
+		if ((products & (PRODUCT_GRAY | PRODUCT_FEATURES | PRODUCT_VHIST)) == 0)
+			continue;
+
+		Frame& src = this->frame.getLevel(this->be, l);
+
+		if ((products & PRODUCT_GRAY) != 0)
+			src.computeGray(this->be);
+		if ((products & PRODUCT_FEATURES) != 0)
+			this->frame.computeFeatures(this->be, l);
+		if ((products & PRODUCT_VHIST) != 0)
+			src.computeFullHist(this->be, V_CHANNEL);
+	}
+}
+
+/**
+* Stop on a product that no metric declared at this level: it would be built behind the plan
+*
+* @param _level (int): pyramid level
+* @param _product (int): PRODUCT_*
+*/
+void Framecontext::require(const int& _level, const int& _product) const
+{
+	if (_level >= 0 && _level < static_cast<int>(this->plan.size()) && (this->plan[_level] & _product) != 0)
+		return;
+
+	cerr << "ERR::a metric reads product " << _product << " at pyramid level " << _level << " without declaring it (Metric::getProducts). Quitting..." << endl;
+	exit(-1);
+}
+
+/**
+* Level with its gray plane
+*
+* @param _level (int): pyramid level, PRODUCT_GRAY declared
+* @return (Frame) the level, its gray plane computed
+*/
+Frame& Framecontext::gray(const int& _level)
+{
+	require(_level, PRODUCT_GRAY);
+
+	Frame& src = this->frame.getLevel(this->be, _level);
+	src.computeGray(this->be);
+	return src;
+}
+
+/**
+* V histogram of a level
+*
+* @param _level (int): pyramid level, PRODUCT_VHIST declared
+* @param _bin_number (int): bins, folded from the full histogram (Frame::computeHist)
+* @return (cv::Mat) bins x 1, CV_32S
+*/
+cv::Mat Framecontext::hist(const int& _level, const int& _bin_number)
+{
+	require(_level, PRODUCT_VHIST);
+
+	return this->frame.getLevel(this->be, _level).computeHist(this->be, V_CHANNEL, _bin_number);
+}
+
+/**
+* Level of the previous frame
+*
+* The previous frame keeps the products of its own iteration: every frame of the history is
+* built with the products of the temporal metrics at least (seed frames), so nothing is
+* computed here.
+*
+* @param _level (int): pyramid level, PRODUCT_PREVIOUS declared
+* @return (Frame*) nullptr out of order, or before the first frame of the history
+*/
+Frame* Framecontext::previous(const int& _level)
+{
+	require(_level, PRODUCT_PREVIOUS);
+
+	if (this->history == nullptr || this->history->prev(1).getFrameCounter() < 0)
+		return nullptr;
+
+	return &this->history->prev(1).getLevel(this->be, _level);
+}
+
+Backend& Framecontext::getBackend()
+{
+	return this->be;
+}
+
+Frame& Framecontext::getFrame()
+{
+	return this->frame;
+}
+
+/// past frames read: one if the metric reads the previous frame
+int Metric::getHistory() const
+{
+	return (getProducts() & PRODUCT_PREVIOUS) != 0 ? 1 : 0;
+}
+
+/// value columns of the output row (frame_n excluded): one, named as the metric
+vector<string> Metric::getColumns() const
+{
+	return vector<string>{ getName() };
+}
+
+/// patch grid of the output, recorded in the headers; nullptr if the metric has no patches
+const int* Metric::getPatchInfo() const
+{
+	return nullptr;
+}
+
+/**
+* Parameters the results depend on, besides video, backend, sampling, size and level
+*
+* Part of the key of the result cache (Videostream::getMetricParams).
+*
+* @return (json) the parameters
+*/
+json Metric::getParams() const
+{
+	return json::object();
+}
+
+/**
+* Settings of the metric for a video
+*
+* @param _setup (Tmetricsetup): level, level size, ROI and patches
+*/
+void Metric::configure(const Tmetricsetup& _setup)
+{
+	this->setup = _setup;
+}
+
+const Tmetricsetup& Metric::getSetup() const
+{
+	return this->setup;
+}
+
+/// computed in order, on the history
+bool Metric::isTemporal() const
+{
+	return getHistory() > 0;
+}
+
+/// registered metrics, the built-in ones first
+vector<pair<string, function<cv::Ptr<Metric>()>>>& Metricregistry::entries()
+{
+	static vector<pair<string, function<cv::Ptr<Metric>()>>> registered = {
+		{ "blur", [] { return cv::Ptr<Metric>(cv::makePtr<Blurmetric>()); } },
+		{ "exposure", [] { return cv::Ptr<Metric>(cv::makePtr<Exposuremetric>()); } },
+		{ "entropy", [] { return cv::Ptr<Metric>(cv::makePtr<Entropymetric>()); } },
+		{ "motion", [] { return cv::Ptr<Metric>(cv::makePtr<Motionmetric>()); } }
+	};
+
+	return registered;
+}
+
+/**
+* Register a metric
+*
+* @param _name (string): key in settings.json and name of the output files
+* @param _factory (function): creates the metric
+* @return (bool) false if the name is taken
+*/
+bool Metricregistry::add(const string& _name, const function<cv::Ptr<Metric>()>& _factory)
+{
+	vector<string> names = Metricregistry::getNames();
+	if (find(names.begin(), names.end(), _name) != names.end())
+		return false;
+
+	Metricregistry::entries().push_back({ _name, _factory });
+	return true;
+}
+
+/// names of the metrics, in registry order
+vector<string> Metricregistry::getNames()
+{
+	vector<string> names;
+	for (const pair<string, function<cv::Ptr<Metric>()>>& entry : Metricregistry::entries())
+		names.push_back(entry.first);
+
+	return names;
+}
+
+/**
+* Create a metric
+*
+* @param _name (string): registered name
+* @return (cv::Ptr<Metric>) the metric, empty if the name is not registered
+*/
+cv::Ptr<Metric> Metricregistry::create(const string& _name)
+{
+	for (const pair<string, function<cv::Ptr<Metric>()>>& entry : Metricregistry::entries())
+		if (entry.first.compare(_name) == 0)
+			return entry.second();
+
+	return cv::Ptr<Metric>();
+}
+
+/**
+* Is a metric enabled in the settings
+*
+* @param _args (Targuments): settings
+* @param _name (string): the metric
+* @return (bool) false if disabled or missing from the settings
+*/
+bool Metricregistry::isEnabled(const Targuments& _args, const string& _name)
+{
+	map<string, bool>::const_iterator it = _args.metrics.find(_name);
+	return it != _args.metrics.end() && it->second;
+}
@@ -0,0 +1,129 @@
+#ifndef __METRIC_H__
+#define __METRIC_H__
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <algorithm>
+#include <opencv2/core.hpp>
+
+#include "json.hpp"
+#include "frame.h"
+#include "backend.hpp"
+#include "ringbuffer.hpp"
+#include "generica.hpp"
+
+// intermediate products a metric reads at its pyramid level (bit mask, see Framecontext)
+#define PRODUCT_GRAY 1			// gray plane (Framecontext::gray)
+#define PRODUCT_VHIST 2			// V histogram (Framecontext::hist)
+#define PRODUCT_FEATURES 4		// features to track, on the gray plane: read on the previous frame
+#define PRODUCT_PREVIOUS 8		// the frame before, with the products of its own iteration (Framecontext::previous)
+
+using namespace std;
+using json = nlohmann::json;
+
+// settings of a metric for a video, see Videostream::createMetrics
+typedef struct
+{
+	int level;				// pyramid level
+	cv::Size size;			// image size at that level
+	cv::Rect roi;			// blur ROI, in pixels of the level
+	int patch_info[4];		// nx, ny, w, h
+}Tmetricsetup;
+
+class Metric;
+
+/**
+* Products of a frame, for the metrics
+*
+* The plan is the union of the products declared by the enabled metrics, for each pyramid
+* level (makePlan). build() computes them once per frame, before the metrics: pyramid level,
+* gray plane, features, V histogram. A product that no enabled metric declares is never built.
+* The products are kept by the Frame that owns them until it is recycled, so metrics read the
+* same ones (gray, hist, previous) and the previous frame in the history still has those of
+* its own iteration. Reading a product that the metric did not declare is an error.
+* The context itself holds no state: it is created for each frame.
+*/
+class Framecontext
+{
+private:
+	Backend& be;
+	Frame& frame;
+	const vector<int>& plan;		// PRODUCT_* of each pyramid level
+	Ringbuffer<Frame>* history;		// nullptr out of order (workers): no previous frame
+
+	void require(const int& _level, const int& _product) const;
+
+public:
+	// Constructors
+	Framecontext(Backend& _be, Frame& _frame, const vector<int>& _plan, Ringbuffer<Frame>* _history = nullptr);
+
+	// methods::products
+	void build();
+	Frame& gray(const int& _level);
+	cv::Mat hist(const int& _level, const int& _bin_number);
+	Frame* previous(const int& _level);
+	static vector<int> makePlan(const vector<cv::Ptr<Metric>>& _metrics, const bool& _temporal_only);
+
+	// methods::getter
+	Backend& getBackend();
+	Frame& getFrame();
+};
+
+/**
+* Metric plugin
+*
+* A metric declares the products it reads (PRODUCT_*, at the level of its setup), how many past
+* frames it needs and the columns of its output row; Videostream only creates the enabled ones
+* (Metricregistry), so that their products, filters and detectors are never built otherwise.
+* compute reads its products from the Framecontext only. Metrics that read past frames are
+* temporal: their compute runs in order, in the writer, while the products of the frame are
+* built in the workers (also on seed frames, which are only decoded for the next one). The
+* others run in the workers, concurrently: compute must not change the metric.
+*/
+class Metric
+{
+protected:
+	Tmetricsetup setup;
+
+public:
+	virtual ~Metric() {}
+
+	// methods::declaration
+	virtual string getName() const = 0;
+	virtual int getProducts() const = 0;
+	virtual int getHistory() const;
+	virtual vector<string> getColumns() const;
+	virtual const int* getPatchInfo() const;
+	virtual json getParams() const;
+
+	// methods::computation
+	virtual void compute(Framecontext& _ctx, vector<float>& _row) const = 0;
+
+	// methods::other
+	void configure(const Tmetricsetup& _setup);
+	const Tmetricsetup& getSetup() const;
+	bool isTemporal() const;
+};
+
+/**
+* Registry of the metric plugins
+*
+* Metrics by name, in the order of their output. The name is the key in settings.json (also
+* in "pyramid_levels") and the name of the output files. The built-in metrics are registered
+* first; add() registers another one before the settings are parsed.
+*/
+class Metricregistry
+{
+private:
+	static vector<pair<string, function<cv::Ptr<Metric>()>>>& entries();
+
+public:
+	static bool add(const string& _name, const function<cv::Ptr<Metric>()>& _factory);
+	static vector<string> getNames();
+	static cv::Ptr<Metric> create(const string& _name);
+	static bool isEnabled(const Targuments& _args, const string& _name);
+};
+
+#endif
@@ -12,6 +12,20 @@ Parser::Parser()
 Parser::Parser(const string& _str)
 {	
 	Generica::splitPath(filesystem::u8path(_str), this->settings_path);
+	this->args.backend = "auto";
+	this->args.workers = 0;
+	this->args.segments = 0;
+	this->args.output_format = OUTPUT_CSV;
+	this->args.resume = true;
+	this->args.trace = false;
+	this->args.counters = false;
+	this->args.progress = 0;
+	this->args.sampling = SAMPLE_ALL;
+	this->args.sample_stride = 1;
+	this->args.sample_fps = 0.0;
+	this->args.sample_ratio = 1.0;
+	this->args.sample_seed = 0;
+	this->args.analysis_height = 0;
 	this->args.blur_roi = vector<int>(ROI_LEN, -1);
 	this->args.patch_grid = vector<int>(GRID_EL, -1);
 }
@@ -43,22 +57,90 @@ void Parser::parseJson()
 	
 	json_file.close();
 
-	// parse video path
-	string video_path_str;
-	j.at("video_path").get_to(video_path_str);
-	Generica::splitPath(filesystem::u8path(video_path_str), this->args.video_path);
+	// parse video path: a file, a directory, a glob or a list of them
+	checkJsonPaths(j, "video_path", this->args.video_paths);
+	this->args.video_path = this->args.video_paths[0];
+
+	// parse optional strings
+	checkJsonString(j, "backend", this->args.backend);
+	checkJsonString(j, "output_format", this->args.output_format);
+	checkJsonString(j, "cache_dir", this->args.cache_dir);
+	checkJsonString(j, "sampling", this->args.sampling);
+
+	if (this->args.output_format.compare(OUTPUT_CSV) != 0 && this->args.output_format.compare(OUTPUT_COLUMNS) != 0
+		&& this->args.output_format.compare(OUTPUT_BOTH) != 0)
+	{
+		cout << "ERR::output_format must be " << OUTPUT_CSV << ", " << OUTPUT_COLUMNS << " or " << OUTPUT_BOTH << ". Quitting..." << endl;
+		exit(-1);
+	}
+
+	// parse optional integers
+	checkJsonInt(j, "workers", this->args.workers);
+	checkJsonInt(j, "segments", this->args.segments);
+	checkJsonInt(j, "sample_stride", this->args.sample_stride);
+	checkJsonInt(j, "sample_seed", this->args.sample_seed);
+	checkJsonInt(j, "analysis_height", this->args.analysis_height);
+	checkJsonInt(j, "progress", this->args.progress);
+
+	// parse optional doubles
+	checkJsonDouble(j, "sample_fps", this->args.sample_fps);
+	checkJsonDouble(j, "sample_ratio", this->args.sample_ratio);
+
+	if (this->args.sampling.compare(SAMPLE_ALL) != 0 && this->args.sampling.compare(SAMPLE_STRIDE) != 0
+		&& this->args.sampling.compare(SAMPLE_FPS) != 0 && this->args.sampling.compare(SAMPLE_RANDOM) != 0
+		&& this->args.sampling.compare(SAMPLE_KEYFRAMES) != 0)
+	{
+		cout << "ERR::sampling must be " << SAMPLE_ALL << ", " << SAMPLE_STRIDE << ", " << SAMPLE_FPS << ", " << SAMPLE_RANDOM
+			 << " or " << SAMPLE_KEYFRAMES << ". Quitting..." << endl;
+		exit(-1);
+	}
+	if (this->args.progress < 0)
+	{
+		cout << "ERR::progress must be 0 (off) or a number of seconds. Quitting..." << endl;
+		exit(-1);
+	}
+	if (this->args.analysis_height < 0)
+	{
+		cout << "ERR::analysis_height must be 0 (native) or positive. Quitting..." << endl;
+		exit(-1);
+	}
+	if (this->args.sampling.compare(SAMPLE_STRIDE) == 0 && this->args.sample_stride < 1)
+	{
+		cout << "ERR::sample_stride must be at least 1. Quitting..." << endl;
+		exit(-1);
+	}
+	if (this->args.sampling.compare(SAMPLE_FPS) == 0 && !(this->args.sample_fps > 0.0))
+	{
+		cout << "ERR::sample_fps must be greater than 0. Quitting..." << endl;
+		exit(-1);
+	}
+	if (this->args.sampling.compare(SAMPLE_RANDOM) == 0 && !(this->args.sample_ratio > 0.0 && this->args.sample_ratio <= 1.0))
+	{
+		cout << "ERR::sample_ratio must be in (0, 1]. Quitting..." << endl;
+		exit(-1);
+	}
 	
-	// parse booleans
-	checkJsonBool(j, "blur", this->args.blur);
-	checkJsonBool(j, "exposure", this->args.exposure);
-	checkJsonBool(j, "entropy", this->args.entropy);
-	checkJsonBool(j, "motion", this->args.motion);
+	// parse booleans: one for each registered metric, disabled if missing
+	for (const string& name : Metricregistry::getNames())
+	{
+		this->args.metrics[name] = false;
+		if (j.contains(name))
+			checkJsonBool(j, name, this->args.metrics[name]);
+	}
+
 	checkJsonBool(j, "debug", this->args.debug);
 	checkJsonBool(j, "show", this->args.show);
+	if (j.contains("resume"))
+		checkJsonBool(j, "resume", this->args.resume);		// optional
+	if (j.contains("trace"))
+		checkJsonBool(j, "trace", this->args.trace);		// optional
+	if (j.contains("counters"))
+		checkJsonBool(j, "counters", this->args.counters);	// optional
 
 	// parse json arrays with check
 	checkJsonArray(j, "blur_roi", this->args.blur_roi, ROI_LEN);
 	checkJsonArray(j, "patch_grid", this->args.patch_grid, GRID_EL);
+	checkJsonLevels(j, "pyramid_levels", this->args.pyramid_levels);		// optional
 }
 
 /**
@@ -99,6 +181,119 @@ void Parser::checkJsonBool(const json& _j, const string& _valname, bool& _bool_a
 	}
 }
 
+/**
+ * Parse optional json string
+ * 
+ * Keys added after the first release are optional, so that old settings files keep working.
+ * If the key is missing, the argument keeps its default value.
+ * 
+ * @param _j (json): file json
+ * @param _valname (string): attribute's name
+ * @param _str_arg (string): the argument to which assign the value
+ */
+void Parser::checkJsonString(const json& _j, const string& _valname, string& _str_arg)
+{
+	if (!_j.contains(_valname))
+		return;
+
+	if (_j.at(_valname).is_string())
+	{
+		_j.at(_valname).get_to(_str_arg);
+	}
+	else
+	{
+		cout << "ERR::" << _valname << " must be a string. Quitting..." << endl;
+		exit(-1);
+	}
+}
+
+/**
+ * Parse optional json integer
+ * 
+ * Same as checkJsonString: if the key is missing, the argument keeps its default value.
+ * 
+ * @param _j (json): file json
+ * @param _valname (string): attribute's name
+ * @param _int_arg (int): the argument to which assign the value
+ */
+void Parser::checkJsonInt(const json& _j, const string& _valname, int& _int_arg)
+{
+	if (!_j.contains(_valname))
+		return;
+
+	if (_j.at(_valname).is_number_integer())
+	{
+		_j.at(_valname).get_to(_int_arg);
+	}
+	else
+	{
+		cout << "ERR::" << _valname << " must be an integer. Quitting..." << endl;
+		exit(-1);
+	}
+}
+
+/**
+ * Parse optional json number
+ * 
+ * Same as checkJsonString: if the key is missing, the argument keeps its default value.
+ * Integers are accepted too.
+ * 
+ * @param _j (json): file json
+ * @param _valname (string): attribute's name
+ * @param _double_arg (double): the argument to which assign the value
+ */
+void Parser::checkJsonDouble(const json& _j, const string& _valname, double& _double_arg)
+{
+	if (!_j.contains(_valname))
+		return;
+
+	if (_j.at(_valname).is_number())
+	{
+		_j.at(_valname).get_to(_double_arg);
+	}
+	else
+	{
+		cout << "ERR::" << _valname << " must be a number. Quitting..." << endl;
+		exit(-1);
+	}
+}
+
+/**
+ * Parse video paths
+ * 
+ * The value is either a string or an array of strings; each one is expanded by
+ * Generica::expandPath (file, directory or glob).
+ * 
+ * @param _j (json): file json
+ * @param _valname (string): attribute's name
+ * @param _tpaths (vector<Tpath>): the videos found
+ */
+void Parser::checkJsonPaths(const json& _j, const string& _valname, vector<Tpath>& _tpaths)
+{
+	if (_j.at(_valname).is_string())
+	{
+		Generica::expandPath(_j.at(_valname).get<string>(), _tpaths);
+	}
+	else if (_j.at(_valname).is_array() && !_j.at(_valname).empty())
+	{
+		for (const json& item : _j.at(_valname))
+		{
+			if (!item.is_string())
+			{
+				cout << "ERR::" << _valname << " must be a string or a list of strings. Quitting..." << endl;
+				exit(-1);
+			}
+
+			Generica::expandPath(item.get<string>(), _tpaths);
+		}
+	}
+	else
+	{
+		cout << "ERR::" << _valname << " must be a string or a list of strings. Quitting..." << endl;
+		exit(-1);
+	}
+}
+
 /**
  * Check array for ROI
  * 
@@ -130,6 +325,46 @@ void Parser::checkJsonArray(const json& _j, const string& _valname, vector<int>&
 	}
 }
 
+/**
+ * Parse optional pyramid levels
+ * 
+ * An object with the level of each metric, by name ({"blur": 1}); metrics left out stay at
+ * level 0, so a metric added with Metricregistry::add is configured like the built-in ones.
+ * 
+ * @param _j (json): the json file
+ * @param _valname (string): argument's name
+ * @param _levels (map<string, int>): the level of each metric found
+ */
+void Parser::checkJsonLevels(const json& _j, const string& _valname, map<string, int>& _levels)
+{
+	if (!_j.contains(_valname))
+		return;
+
+	if (!_j.at(_valname).is_object())
+	{
+		cout << "ERR::" << _valname << " must be an object, e.g. {\"blur\": 1}. Quitting..." << endl;
+		exit(-1);
+	}
+
+	vector<string> names = Metricregistry::getNames();
+	for (const auto& item : _j.at(_valname).items())
+	{
+		if (find(names.begin(), names.end(), item.key()) == names.end())
+		{
+			cout << "ERR::" << _valname << ": " << item.key() << " is not a metric. Quitting..." << endl;
+			exit(-1);
+		}
+
+		if (!item.value().is_number_integer() || item.value().get<int>() < 0 || item.value().get<int>() > PYRAMID_MAX_LEVEL)
+		{
+			cout << "ERR::" << _valname << " must be in [0, " << PYRAMID_MAX_LEVEL << "]. Quitting..." << endl;
+			exit(-1);
+		}
+
+		_levels[item.key()] = item.value().get<int>();
+	}
+}
+
 /** Custom print
 * 
 * Access Targument and define a way to print all its elements
@@ -141,12 +376,27 @@ void Parser::checkJsonArray(const json& _j, const string& _valname, vector<int>&
 ostream& operator<<(ostream& _os, const Parser& _p)
 {
 	_os << "video_path::" << endl << _p.args.video_path << endl
-		<< "blur: " << _p.args.blur << endl
-		<< "exposure: " << _p.args.exposure << endl
-		<< "entropy: " << _p.args.entropy << endl
-		<< "motion: " << _p.args.motion << endl
+		<< "videos: " << _p.args.video_paths.size() << endl
+		<< "backend: " << _p.args.backend << endl
+		<< "workers: " << _p.args.workers << endl
+		<< "segments: " << _p.args.segments << endl
+		<< "output_format: " << _p.args.output_format << endl
+		<< "cache_dir: " << _p.args.cache_dir << endl
+		<< "sampling: " << _p.args.sampling << " (stride " << _p.args.sample_stride << ", fps " << _p.args.sample_fps
+		<< ", ratio " << _p.args.sample_ratio << ", seed " << _p.args.sample_seed << ")" << endl
+		<< "analysis_height: " << _p.args.analysis_height << endl
+		<< "metrics:";
+
+	for (map<string, bool>::const_iterator it = _p.args.metrics.begin(); it != _p.args.metrics.end(); it++)
+		_os << " " << it->first << "=" << it->second;
+
+	_os << endl
 		<< "debug: " << _p.args.debug << endl
 		<< "show: " << _p.args.show << endl
+		<< "resume: " << _p.args.resume << endl
+		<< "trace: " << _p.args.trace << endl
+		<< "counters: " << _p.args.counters << endl
+		<< "progress: " << _p.args.progress << endl
 		<< "blur roi: [";
 
 	for (int i = 0; i < ROI_LEN; i++)
@@ -159,7 +409,14 @@ ostream& operator<<(ostream& _os, const Parser& _p)
 	for (int i = 0; i < GRID_EL; i++)
 		_os << _p.args.patch_grid[i] << ",";
 
-	_os << "]" << endl;
+	_os << "]" << endl
+
+		<< "pyramid_levels: {";
+
+	for (const pair<const string, int>& level : _p.args.pyramid_levels)
+		_os << level.first << ": " << level.second << ",";
+
+	_os << "}" << endl;
 
 	return _os;
 }
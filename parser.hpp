@@ -6,6 +6,7 @@
 
 #include "json.hpp"		// https://kezunlin.me/post/f3c3eb8/
 #include "generica.hpp"
+#include "metric.hpp"
 
 using namespace std;
 using json = nlohmann::json;
@@ -27,7 +28,12 @@ public:
 
 	// methods::other methods
 	void checkJsonBool(const json& _j, const string& _valname, bool& _bool_arg);
+	void checkJsonString(const json& _j, const string& _valname, string& _str_arg);
+	void checkJsonInt(const json& _j, const string& _valname, int& _int_arg);
+	void checkJsonDouble(const json& _j, const string& _valname, double& _double_arg);
+	void checkJsonPaths(const json& _j, const string& _valname, vector<Tpath>& _tpaths);
 	void checkJsonArray(const json& _j, const string& _valname, vector<int>& _vec, const int& _vec_size);
+	void checkJsonLevels(const json& _j, const string& _valname, map<string, int>& _levels);
 
 	// operator overload
 	friend ostream& operator<<(ostream& _os, const Parser& _p);
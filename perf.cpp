@@ -0,0 +1,603 @@
+#include "perf.hpp"
+
+atomic<uint64_t> Perf::next_id(1);
+atomic<int> Perf::next_tid(1);
+thread_local Perf* Perf::current = nullptr;
+thread_local const char* Perf::role = "";
+thread_local int Perf::tid = 0;
+thread_local Ttracebuffer* Perf::local_buffer = nullptr;
+thread_local uint64_t Perf::local_owner = 0;
+thread_local uint64_t Stagetimer::children_ns = 0;
+thread_local uint64_t Stagetimer::children_counts[COUNTER_N] = { 0, 0, 0, 0 };
+thread_local uint64_t Stagetimer::band_counts[COUNTER_N] = { 0, 0, 0, 0 };
+thread_local int Stagetimer::counting_depth = 0;
+thread_local Hwcounters Stagetimer::counters;
+atomic<bool> Hwcounters::unavailable(false);
+
+Perf::Perf()
+{
+	for (int s = 0; s < STAGE_N; s++)
+	{
+		for (int b = 0; b < PERF_BINS; b++)
+			this->bins[s][b].store(0, memory_order_relaxed);
+
+		this->total_ns[s].store(0, memory_order_relaxed);
+		this->max_ns[s].store(0, memory_order_relaxed);
+		this->counted[s].store(0, memory_order_relaxed);
+
+		for (int c = 0; c < COUNTER_N; c++)
+			this->counts[s][c].store(0, memory_order_relaxed);
+	}
+
+	this->frames.store(0, memory_order_relaxed);
+	this->start = chrono::steady_clock::now();
+	this->id = Perf::next_id.fetch_add(1);
+	this->tracing = false;
+	this->buffers.store(nullptr);
+	this->counting = false;
+}
+
+Perf::~Perf()
+{
+	Ttracebuffer* buf = this->buffers.load();
+	while (buf != nullptr)
+	{
+		Ttracebuffer* next = buf->next;
+		delete buf;
+		buf = next;
+	}
+}
+
+/**
+* Record a duration
+*
+* @param _stage (int): STAGE_*
+* @param _ns (uint64_t): duration in nanoseconds
+*/
+void Perf::record(const int& _stage, const uint64_t& _ns)
+{
+	this->bins[_stage][Perf::toBin(_ns)].fetch_add(1, memory_order_relaxed);
+	this->total_ns[_stage].fetch_add(_ns, memory_order_relaxed);
+
+	uint64_t m = this->max_ns[_stage].load(memory_order_relaxed);
+	while (_ns > m && !this->max_ns[_stage].compare_exchange_weak(m, _ns, memory_order_relaxed))
+		;
+}
+
+/// one more frame written
+void Perf::addFrame()
+{
+	this->frames.fetch_add(1, memory_order_relaxed);
+}
+
+/// frames written so far, from any thread
+long Perf::getFrames() const
+{
+	return this->frames.load(memory_order_relaxed);
+}
+
+/**
+* Totals and latency percentiles of each stage
+*
+* Stages that never ran are left out. ms_per_frame divides the stage total by the frames
+* written, so that stages of frames decoded but not written (seeds, skips) count as well.
+*
+* With counting on, the Frame stages also have per-frame hardware counts and IPC, and
+* "counters" tells whether they were available. "counters_threads" tells how work on other
+* threads is counted: "bands summed", the row bands of the toolbox kernels (box resize, blur,
+* V histogram) are read on the threads that run them and added to their stage.
+*
+* @return (json) frames, wall_s, fps, ms_per_frame, counters, counters_threads and stages
+*/
+json Perf::report() const
+{
+	const double wall = chrono::duration<double>(chrono::steady_clock::now() - this->start).count();
+	const long n = this->frames.load(memory_order_relaxed);
+
+	json r = json::object();
+	r["frames"] = n;
+	r["wall_s"] = wall;
+	r["fps"] = wall > 0.0 ? n / wall : 0.0;
+	r["ms_per_frame"] = n > 0 ? wall * 1e3 / n : 0.0;
+	if (this->counting)
+	{
+		r["counters"] = Hwcounters::isUnavailable() ? "unavailable" : "available";
+		r["counters_threads"] = "bands summed";
+	}
+	r["stages"] = json::object();
+
+	for (int s = 0; s < STAGE_N; s++)
+	{
+		uint64_t count = 0;
+		for (int b = 0; b < PERF_BINS; b++)
+			count += this->bins[s][b].load(memory_order_relaxed);
+
+		if (count == 0)
+			continue;
+
+		const double total = static_cast<double>(this->total_ns[s].load(memory_order_relaxed));
+		json st = json::object();
+		st["count"] = count;
+		st["total_ms"] = total * 1e-6;
+		st["ms_per_frame"] = n > 0 ? total * 1e-6 / n : 0.0;
+		st["mean_us"] = total * 1e-3 / count;
+		st["p50_us"] = percentile(s, 0.50) * 1e-3;
+		st["p95_us"] = percentile(s, 0.95) * 1e-3;
+		st["p99_us"] = percentile(s, 0.99) * 1e-3;
+		st["max_us"] = this->max_ns[s].load(memory_order_relaxed) * 1e-3;
+
+		const uint64_t samples = this->counted[s].load(memory_order_relaxed);
+		if (samples > 0 && n > 0)
+		{
+			const double cycles = static_cast<double>(this->counts[s][COUNTER_CYCLES].load(memory_order_relaxed));
+			const double instructions = static_cast<double>(this->counts[s][COUNTER_INSTRUCTIONS].load(memory_order_relaxed));
+
+			json hw = json::object();
+			hw["cycles_per_frame"] = cycles / n;
+			hw["instructions_per_frame"] = instructions / n;
+			hw["llc_misses_per_frame"] = this->counts[s][COUNTER_LLC_MISSES].load(memory_order_relaxed) / static_cast<double>(n);
+			hw["branch_misses_per_frame"] = this->counts[s][COUNTER_BRANCH_MISSES].load(memory_order_relaxed) / static_cast<double>(n);
+			hw["ipc"] = cycles > 0.0 ? instructions / cycles : 0.0;
+			hw["samples"] = samples;
+			st["counters"] = hw;
+		}
+
+		r["stages"][Perf::stageName(s)] = st;
+	}
+
+	return r;
+}
+
+/**
+* Write <name>_meta/perf.json
+*
+* Written atomically (temporary file + rename), as the checkpoint.
+*
+* @param _meta_dir (string): output directory of the video
+* @param _info (json): fields added to the report (video, backend, ...)
+*/
+void Perf::save(const string& _meta_dir, const json& _info) const
+{
+	json r = _info;
+	r.update(report());
+
+	filesystem::path path = filesystem::u8path(_meta_dir) / PERF_FILE;
+	filesystem::path tmp_path = path;
+	tmp_path += ".tmp";
+	{
+		ofstream tmp(tmp_path, ios_base::trunc);
+		tmp << r.dump(1, '\t') << endl;
+	}
+	filesystem::rename(tmp_path, path);
+}
+
+/**
+* Latency at a percentile
+*
+* @param _stage (int): STAGE_*
+* @param _p (double): percentile in [0, 1]
+* @return (double) nanoseconds, middle of the histogram bin (never above the maximum)
+*/
+double Perf::percentile(const int& _stage, const double& _p) const
+{
+	uint64_t count = 0, seen = 0;
+	for (int b = 0; b < PERF_BINS; b++)
+		count += this->bins[_stage][b].load(memory_order_relaxed);
+
+	const uint64_t target = max<uint64_t>(1, static_cast<uint64_t>(ceil(_p * count)));
+	const double m = static_cast<double>(this->max_ns[_stage].load(memory_order_relaxed));
+
+	for (int b = 0; b < PERF_BINS; b++)
+	{
+		seen += this->bins[_stage][b].load(memory_order_relaxed);
+		if (seen >= target)
+			return min(Perf::fromBin(b), m);
+	}
+
+	return m;
+}
+
+/**
+* Histogram bin of a duration
+*
+* 0..7 ns have a bin each; above, every power of two [2^e, 2^(e+1)) is split in PERF_SUB bins.
+*
+* @param _ns (uint64_t): duration
+* @return (int) bin, < PERF_BINS
+*/
+int Perf::toBin(const uint64_t& _ns)
+{
+	if (_ns < PERF_SUB)
+		return static_cast<int>(_ns);
+
+	int e = 3;
+	while ((_ns >> (e + 1)) != 0)
+		e += 1;
+
+	return PERF_SUB + (e - 3) * PERF_SUB + static_cast<int>((_ns >> (e - 3)) - PERF_SUB);
+}
+
+/// middle of a bin, in nanoseconds
+double Perf::fromBin(const int& _bin)
+{
+	if (_bin < PERF_SUB)
+		return _bin;
+
+	const int e = 3 + (_bin - PERF_SUB) / PERF_SUB;
+	const int sub = (_bin - PERF_SUB) % PERF_SUB;
+
+	return ldexp(PERF_SUB + sub + 0.5, e - 3);
+}
+
+/**
+* Keep the spans of the timers, for saveTrace
+*
+* Set before the threads start: it is read without synchronization.
+*
+* @param _tracing (bool): on or off
+*/
+void Perf::setTracing(const bool& _tracing)
+{
+	this->tracing = _tracing;
+}
+
+bool Perf::isTracing() const
+{
+	return this->tracing;
+}
+
+/**
+* Add a span to the buffer of the calling thread
+*
+* The first span of a thread in this Perf creates its buffer and pushes it on the list with a
+* compare-and-swap; after that, a span is an append to memory that no other thread touches.
+* A thread that comes back from another Perf (batch: a pool thread on several videos) finds
+* its buffer in the list, so that TRACE_MAX_SPANS holds per thread and per Perf.
+*
+* @param _stage (int): STAGE_*
+* @param _frame (int): frame number, -1 if none
+* @param _t0 (time_point): start of the span
+* @param _dur_ns (uint64_t): duration
+*/
+void Perf::trace(const int& _stage, const int& _frame, const chrono::steady_clock::time_point& _t0, const uint64_t& _dur_ns)
+{
+	if (Perf::local_owner != this->id)
+	{
+		if (Perf::tid == 0)
+			Perf::tid = Perf::next_tid.fetch_add(1);
+
+		// tid and next do not change once a buffer is on the list
+		Ttracebuffer* buf = this->buffers.load(memory_order_acquire);
+		while (buf != nullptr && buf->tid != Perf::tid)
+			buf = buf->next;
+
+		if (buf == nullptr)
+		{
+			buf = new Ttracebuffer();
+			buf->spans.reserve(TRACE_RESERVE);
+			buf->tid = Perf::tid;
+			buf->role = Perf::role;
+			buf->dropped = 0;
+			buf->next = this->buffers.load(memory_order_relaxed);
+			while (!this->buffers.compare_exchange_weak(buf->next, buf, memory_order_release, memory_order_relaxed))
+				;
+		}
+
+		Perf::local_buffer = buf;
+		Perf::local_owner = this->id;
+	}
+
+	Ttracebuffer* buf = Perf::local_buffer;
+	if (buf->spans.size() >= TRACE_MAX_SPANS)
+	{
+		buf->dropped += 1;
+		return;
+	}
+
+	int64_t begin = chrono::duration_cast<chrono::nanoseconds>(_t0 - this->start).count();
+	buf->spans.push_back({ _stage, _frame, begin, static_cast<int64_t>(_dur_ns) });
+}
+
+/**
+* Write <name>_meta/trace.json
+*
+* Chrome trace-event format (chrome://tracing, ui.perfetto.dev): a complete event ("X") per
+* span, with the frame number in args, and the name of each thread. Call it once the threads
+* that record in this Perf are done. Written atomically, as the report.
+*
+* @param _meta_dir (string): output directory of the video
+* @param _info (json): stored in otherData
+*/
+void Perf::saveTrace(const string& _meta_dir, const json& _info) const
+{
+	filesystem::path path = filesystem::u8path(_meta_dir) / TRACE_FILE;
+	filesystem::path tmp_path = path;
+	tmp_path += ".tmp";
+
+	json other = _info;
+	long dropped = 0;
+	char line[256];
+	{
+		ofstream tmp(tmp_path, ios_base::trunc);
+		tmp << "{\"traceEvents\":[\n";
+
+		bool first = true;
+		for (const Ttracebuffer* buf = this->buffers.load(memory_order_acquire); buf != nullptr; buf = buf->next)
+		{
+			json name = { { "name", "thread_name" }, { "ph", "M" }, { "pid", 1 }, { "tid", buf->tid }, { "args", { { "name", buf->role.empty() ? "thread" : buf->role } } } };
+			tmp << (first ? "" : ",\n") << name.dump();
+			first = false;
+			dropped += buf->dropped;
+
+			for (const Tspan& sp : buf->spans)
+			{
+				snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"cat\":\"stage\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%d}}",
+					Perf::stageName(sp.stage), buf->tid, sp.begin_ns * 1e-3, sp.dur_ns * 1e-3, sp.frame);
+				tmp << line;
+			}
+		}
+
+		other["dropped_spans"] = dropped;
+		tmp << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":" << other.dump() << "}" << endl;
+	}
+	filesystem::rename(tmp_path, path);
+}
+
+/**
+* Read the hardware counters in the timers of the Frame stages
+*
+* Set before the threads start, as tracing.
+*
+* @param _counting (bool): on or off
+*/
+void Perf::setCounting(const bool& _counting)
+{
+	this->counting = _counting;
+}
+
+bool Perf::isCounting() const
+{
+	return this->counting;
+}
+
+/**
+* Add the self counts of a timer
+*
+* @param _stage (int): STAGE_*
+* @param _values (uint64_t[COUNTER_N]): counts, COUNTER_*
+*/
+void Perf::count(const int& _stage, const uint64_t _values[])
+{
+	for (int c = 0; c < COUNTER_N; c++)
+		this->counts[_stage][c].fetch_add(_values[c], memory_order_relaxed);
+
+	this->counted[_stage].fetch_add(1, memory_order_relaxed);
+}
+
+Perf* Perf::getCurrent()
+{
+	return Perf::current;
+}
+
+/**
+* Attach a Perf to the calling thread
+*
+* @param _perf (Perf*): the timers of this thread record in it; nullptr to detach
+* @param _role (char*): name of the thread in the trace (decoder, worker, ...)
+*/
+void Perf::setCurrent(Perf* _perf, const char* _role)
+{
+	Perf::current = _perf;
+	Perf::role = _role;
+}
+
+const char* Perf::stageName(const int& _stage)
+{
+	static const char* names[STAGE_N] = { "decode", "resize", "gray", "hist", "blur", "exposure", "entropy",
+		"features", "motion", "write", "show" };
+
+	return names[_stage];
+}
+
+Stagetimer::Stagetimer(const int& _stage, const int& _frame)
+{
+	this->perf = Perf::getCurrent();
+	this->stage = _stage;
+	this->frame = _frame;
+	this->outer_children = 0;
+	this->counting = false;
+
+	if (this->perf == nullptr)
+		return;
+
+	this->outer_children = Stagetimer::children_ns;
+	Stagetimer::children_ns = 0;
+
+	if (this->perf->isCounting() && STAGE_COUNTED(_stage) && Stagetimer::counters.read(this->c0))
+	{
+		this->counting = true;
+		for (int c = 0; c < COUNTER_N; c++)
+		{
+			this->outer_children_counts[c] = Stagetimer::children_counts[c];
+			Stagetimer::children_counts[c] = 0;
+			this->outer_band_counts[c] = Stagetimer::band_counts[c];
+			Stagetimer::band_counts[c] = 0;
+		}
+		Stagetimer::counting_depth++;
+	}
+
+	this->t0 = chrono::steady_clock::now();
+}
+
+Stagetimer::~Stagetimer()
+{
+	if (this->perf == nullptr)
+		return;
+
+	uint64_t elapsed = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - this->t0).count());
+	uint64_t self = elapsed > Stagetimer::children_ns ? elapsed - Stagetimer::children_ns : 0;
+
+	if (this->counting)
+	{
+		uint64_t c1[COUNTER_N];
+		if (Stagetimer::counters.read(c1))
+		{
+			// same self/children split as the time; counters only go up, a scaled estimate may not.
+			// Bands run by other threads belong to this stage only: the enclosing timers never see them
+			uint64_t self_counts[COUNTER_N];
+			for (int c = 0; c < COUNTER_N; c++)
+			{
+				uint64_t total = c1[c] > this->c0[c] ? c1[c] - this->c0[c] : 0;
+				self_counts[c] = (total > Stagetimer::children_counts[c] ? total - Stagetimer::children_counts[c] : 0) + Stagetimer::band_counts[c];
+				Stagetimer::children_counts[c] = this->outer_children_counts[c] + total;
+			}
+			this->perf->count(this->stage, self_counts);
+		}
+
+		for (int c = 0; c < COUNTER_N; c++)
+			Stagetimer::band_counts[c] = this->outer_band_counts[c];
+		Stagetimer::counting_depth--;
+	}
+
+	this->perf->record(this->stage, self);
+	if (this->perf->isTracing())
+		this->perf->trace(this->stage, this->frame, this->t0, elapsed);
+	Stagetimer::children_ns = this->outer_children + elapsed;
+}
+
+Bandcounter::Bandcounter()
+{
+	this->active = Stagetimer::counting_depth > 0;
+	this->owner = this_thread::get_id();
+
+	for (int c = 0; c < COUNTER_N; c++)
+		this->counts[c].store(0, memory_order_relaxed);
+}
+
+/// add the counts of the bands to the innermost counting timer of the calling thread
+Bandcounter::~Bandcounter()
+{
+	if (!this->active)
+		return;
+
+	for (int c = 0; c < COUNTER_N; c++)
+		Stagetimer::band_counts[c] += this->counts[c].load(memory_order_relaxed);
+}
+
+Bandcounter::Band::Band(Bandcounter& _parent) : parent(_parent)
+{
+	this->counting = _parent.active && this_thread::get_id() != _parent.owner && Stagetimer::counters.read(this->c0);
+}
+
+Bandcounter::Band::~Band()
+{
+	uint64_t c1[COUNTER_N];
+	if (!this->counting || !Stagetimer::counters.read(c1))
+		return;
+
+	for (int c = 0; c < COUNTER_N; c++)
+		this->parent.counts[c].fetch_add(c1[c] > this->c0[c] ? c1[c] - this->c0[c] : 0, memory_order_relaxed);
+}
+
+Hwcounters::Hwcounters()
+{
+	for (int c = 0; c < COUNTER_N; c++)
+		this->fds[c] = -1;
+
+	this->state = 0;
+}
+
+Hwcounters::~Hwcounters()
+{
+#if defined(__linux__)
+	for (int c = COUNTER_N - 1; c >= 0; c--)
+		if (this->fds[c] >= 0)
+			close(this->fds[c]);
+#endif
+}
+
+/**
+* Open the group of counters of the calling thread
+*
+* @return (bool) false if any counter cannot be opened: then none is used
+*/
+bool Hwcounters::open()
+{
+#if defined(__linux__)
+	static const uint64_t configs[COUNTER_N] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+
+	for (int c = 0; c < COUNTER_N; c++)
+	{
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = configs[c];
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		// this thread, any cpu; the first counter leads the group, so that all are read at once
+		long fd = syscall(SYS_perf_event_open, &attr, 0, -1, c == 0 ? -1 : this->fds[0], 0);
+		if (fd < 0)
+		{
+			if (!Hwcounters::unavailable.exchange(true))
+				cout << "WARNING::hardware counters not available (" << strerror(errno) << "): perf.json without counters" << endl;
+
+			for (int k = c - 1; k >= 0; k--)
+			{
+				close(this->fds[k]);
+				this->fds[k] = -1;
+			}
+			return false;
+		}
+
+		this->fds[c] = static_cast<int>(fd);
+	}
+
+	return true;
+#else
+	if (!Hwcounters::unavailable.exchange(true))
+		cout << "WARNING::hardware counters are only available on Linux: perf.json without counters" << endl;
+
+	return false;
+#endif
+}
+
+/**
+* Current counts of the calling thread
+*
+* Counts are scaled by enabled/running time when the kernel multiplexes the counters.
+*
+* @param _values (uint64_t[COUNTER_N]): output, COUNTER_*
+* @return (bool) false if the counters are not available
+*/
+bool Hwcounters::read(uint64_t _values[])
+{
+	if (this->state == 0)
+		this->state = Hwcounters::unavailable.load(memory_order_relaxed) || !open() ? -1 : 1;
+
+	if (this->state < 0)
+		return false;
+
+#if defined(__linux__)
+	// PERF_FORMAT_GROUP: nr, time enabled, time running, one value per counter
+	uint64_t buf[3 + COUNTER_N];
+	if (::read(this->fds[0], buf, sizeof(buf)) != static_cast<ssize_t>(sizeof(buf)) || buf[0] != COUNTER_N)
+		return false;
+
+	const double scale = buf[2] > 0 && buf[2] < buf[1] ? static_cast<double>(buf[1]) / buf[2] : 1.0;
+	for (int c = 0; c < COUNTER_N; c++)
+		_values[c] = static_cast<uint64_t>(buf[3 + c] * scale);
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool Hwcounters::isUnavailable()
+{
+	return Hwcounters::unavailable.load(memory_order_relaxed);
+}
@@ -0,0 +1,263 @@
+#ifndef __PERF_H__
+#define __PERF_H__
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+
+#include "json.hpp"
+
+#if defined(__linux__)
+	#include <unistd.h>
+	#include <sys/syscall.h>
+	#include <linux/perf_event.h>
+#endif
+
+#define PERF_FILE "perf.json"
+#define TRACE_FILE "trace.json"
+#define TRACE_RESERVE 4096				// spans reserved per thread buffer
+#define TRACE_MAX_SPANS (1 << 22)		// per thread buffer (~100 MB): later spans are dropped and counted
+
+// stages of the processing; nested stages are subtracted from the enclosing one
+#define STAGE_DECODE 0			// reader: decode (or skip) a frame
+#define STAGE_RESIZE 1			// analysis resolution and pyramid levels
+#define STAGE_GRAY 2			// colour conversion to the gray plane
+#define STAGE_HIST 3			// colour conversion to V and histogram
+#define STAGE_BLUR 4
+#define STAGE_EXPOSURE 5
+#define STAGE_ENTROPY 6
+#define STAGE_FEATURES 7		// features to track, for motion
+#define STAGE_MOTION 8
+#define STAGE_WRITE 9			// formatting and buffering of the outputs
+#define STAGE_SHOW 10			// display
+#define STAGE_N 11
+
+#define STAGE_COUNTED(s) ((s) >= STAGE_RESIZE && (s) <= STAGE_MOTION)	// Frame::compute* stages
+
+// hardware counters, user space only (Linux perf_event_open)
+#define COUNTER_CYCLES 0
+#define COUNTER_INSTRUCTIONS 1
+#define COUNTER_LLC_MISSES 2	// last level cache misses (PERF_COUNT_HW_CACHE_MISSES)
+#define COUNTER_BRANCH_MISSES 3
+#define COUNTER_N 4
+
+#define PERF_SUB 8				// histogram bins per power of two: values within 1/8
+#define PERF_BINS (PERF_SUB + 61 * PERF_SUB)	// 0..7 ns linear, then up to 2^64 ns
+
+using namespace std;
+using json = nlohmann::json;
+
+// a timed stage, for the trace
+typedef struct
+{
+	int stage;
+	int frame;				// -1 if the stage is not about a frame
+	int64_t begin_ns;		// since the start of the Perf
+	int64_t dur_ns;
+}Tspan;
+
+// spans of one thread: written by that thread only, read once all threads are done
+typedef struct Ttracebuffer
+{
+	vector<Tspan> spans;
+	int tid;
+	string role;
+	long dropped;
+	Ttracebuffer* next;		// lock-free list of the buffers of a Perf
+}Ttracebuffer;
+
+/**
+* Hardware counters of the calling thread
+*
+* One perf_event_open group per thread (cycles, instructions, LLC misses, branch misses), opened
+* on the first read and closed when the thread ends. If the kernel refuses the counters
+* (containers, perf_event_paranoid, virtual machines, other platforms) a warning is printed
+* once and every later read fails at once, without system calls.
+*/
+class Hwcounters
+{
+private:
+	int fds[COUNTER_N];
+	int state;							// 0 not opened, 1 open, -1 unavailable
+
+	static atomic<bool> unavailable;	// any thread failed: do not try again
+
+	bool open();
+
+public:
+	// Constructors
+	Hwcounters();
+	~Hwcounters();
+
+	Hwcounters(const Hwcounters&) = delete;
+	Hwcounters& operator=(const Hwcounters&) = delete;
+
+	// methods
+	bool read(uint64_t _values[]);
+	static bool isUnavailable();
+};
+
+/**
+* Per-stage timing of a video
+*
+* Each stage has a latency histogram with logarithmic bins (PERF_SUB per power of two, so a
+* percentile is within ~6% of the true value), a total and a maximum, all relaxed atomics:
+* any thread can record without locks. Threads working on a video attach its Perf
+* (setCurrent), so that the timers placed in Frame and in the pipeline find it without
+* passing it around; timers of a thread with no Perf attached do nothing.
+*
+* With tracing on, every timer is also kept as a span in a buffer owned by its thread
+* (created on the first span and pushed on a lock-free list), so that threads never contend;
+* saveTrace writes them as Chrome trace events once the threads are done.
+*
+* With counting on, the timers of the Frame stages also read the hardware counters of their
+* thread (Hwcounters) and add the self counts to the stage, for IPC and misses per frame.
+* The row bands of the toolbox kernels that run on other threads are added by Bandcounter.
+*/
+class Perf
+{
+private:
+	atomic<uint64_t> bins[STAGE_N][PERF_BINS];
+	atomic<uint64_t> total_ns[STAGE_N];
+	atomic<uint64_t> max_ns[STAGE_N];
+	atomic<long> frames;
+	chrono::steady_clock::time_point start;
+	uint64_t id;							// tells Perf objects apart, also at the same address
+	bool tracing;
+	atomic<Ttracebuffer*> buffers;
+	bool counting;
+	atomic<uint64_t> counts[STAGE_N][COUNTER_N];
+	atomic<uint64_t> counted[STAGE_N];		// timers that read the counters
+
+	static atomic<uint64_t> next_id;
+	static atomic<int> next_tid;
+	static thread_local Perf* current;
+	static thread_local const char* role;
+	static thread_local int tid;
+	static thread_local Ttracebuffer* local_buffer;	// buffer of this thread in the Perf local_owner
+	static thread_local uint64_t local_owner;
+
+	static int toBin(const uint64_t& _ns);
+	static double fromBin(const int& _bin);
+	double percentile(const int& _stage, const double& _p) const;
+
+public:
+	// Constructors
+	Perf();
+	~Perf();
+
+	Perf(const Perf&) = delete;
+	Perf& operator=(const Perf&) = delete;
+
+	// methods
+	void record(const int& _stage, const uint64_t& _ns);
+	void addFrame();
+	long getFrames() const;
+	json report() const;
+	void save(const string& _meta_dir, const json& _info) const;
+
+	// methods::trace
+	void setTracing(const bool& _tracing);
+	bool isTracing() const;
+	void trace(const int& _stage, const int& _frame, const chrono::steady_clock::time_point& _t0, const uint64_t& _dur_ns);
+	void saveTrace(const string& _meta_dir, const json& _info) const;
+
+	// methods::counters
+	void setCounting(const bool& _counting);
+	bool isCounting() const;
+	void count(const int& _stage, const uint64_t _values[]);
+
+	// methods::thread
+	static Perf* getCurrent();
+	static void setCurrent(Perf* _perf, const char* _role = "");
+	static const char* stageName(const int& _stage);
+};
+
+/**
+* Scoped timer of a stage
+*
+* Records the time between construction and destruction in the Perf of the thread, minus
+* the time of the timers nested in it (self time), so the stages do not count twice.
+* The trace gets the whole time: nesting is visible there.
+*/
+class Stagetimer
+{
+private:
+	Perf* perf;
+	int stage;
+	int frame;
+	chrono::steady_clock::time_point t0;
+	uint64_t outer_children;		// children time of the enclosing timer, restored at the end
+	bool counting;
+	uint64_t c0[COUNTER_N];
+	uint64_t outer_children_counts[COUNTER_N];
+	uint64_t outer_band_counts[COUNTER_N];
+
+	static thread_local uint64_t children_ns;
+	static thread_local uint64_t children_counts[COUNTER_N];
+	static thread_local uint64_t band_counts[COUNTER_N];	// bands run by other threads for the innermost counting timer
+	static thread_local int counting_depth;					// counting timers open on this thread
+	static thread_local Hwcounters counters;
+
+	friend class Bandcounter;
+
+public:
+	Stagetimer(const int& _stage, const int& _frame = -1);
+	~Stagetimer();
+
+	Stagetimer(const Stagetimer&) = delete;
+	Stagetimer& operator=(const Stagetimer&) = delete;
+};
+
+/**
+* Hardware counts of the row bands of a cv::parallel_for_
+*
+* The bands run on OpenCV pool threads, whose counters the timer of the calling thread does
+* not see. Each band reads the counters of its own thread (Band, in the parallel_for_ body)
+* and the sums go to the innermost counting timer of the calling thread when the Bandcounter
+* is destroyed. Bands run by the calling thread are already in its counters and are skipped.
+* Without a counting timer open on the calling thread it does nothing.
+*/
+class Bandcounter
+{
+private:
+	bool active;
+	thread::id owner;
+	atomic<uint64_t> counts[COUNTER_N];
+
+public:
+	Bandcounter();
+	~Bandcounter();
+
+	Bandcounter(const Bandcounter&) = delete;
+	Bandcounter& operator=(const Bandcounter&) = delete;
+
+	// scope of the bands run by one parallel_for_ body
+	class Band
+	{
+	private:
+		Bandcounter& parent;
+		bool counting;
+		uint64_t c0[COUNTER_N];
+
+	public:
+		Band(Bandcounter& _parent);
+		~Band();
+
+		Band(const Band&) = delete;
+		Band& operator=(const Band&) = delete;
+	};
+};
+
+#endif
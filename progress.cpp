@@ -0,0 +1,193 @@
+#include "progress.hpp"
+
+Progress::Progress()
+{
+	this->interval = 0;
+	this->total = 0;
+	this->last_frames = 0;
+	this->running = false;
+}
+
+Progress::~Progress()
+{
+	if (this->monitor.joinable())
+		stop(STATUS_STOPPED);
+}
+
+/**
+* Start the monitor thread
+*
+* @param _name (string): the video, as printed
+* @param _meta_dir (string): output directory of the video, for status.json
+* @param _interval (int): seconds between two updates (> 0)
+* @param _total (long): frames to write
+* @param _frames (function): frames written so far, safe to call from another thread
+*/
+void Progress::start(const string& _name, const string& _meta_dir, const int& _interval, const long& _total, const function<long()>& _frames)
+{
+	if (this->monitor.joinable() || _interval <= 0)
+		return;
+
+	this->name = _name;
+	this->status_path = (filesystem::u8path(_meta_dir) / STATUS_FILE).string();
+	this->interval = _interval;
+	this->total = _total;
+	this->frames = _frames;
+	this->start_time = chrono::steady_clock::now();
+	this->last_time = this->start_time;
+	this->last_frames = 0;
+	this->running = true;
+
+	update(STATUS_RUNNING);
+	this->monitor = thread(&Progress::loop, this);
+}
+
+/**
+* Stop the monitor and write the final status
+*
+* @param _state (string): STATUS_DONE or STATUS_STOPPED
+*/
+void Progress::stop(const string& _state)
+{
+	if (!this->monitor.joinable())
+		return;
+
+	{
+		lock_guard<mutex> lk(this->lock);
+		this->running = false;
+	}
+	this->wake.notify_all();
+	this->monitor.join();
+
+	update(_state);
+}
+
+/**
+* Sample a queue of the pipeline at every update
+*
+* @param _name (string): the queue
+* @param _size (function): approximate number of elements, safe to call from another thread
+* @param _capacity (size_t): capacity of the queue
+*/
+void Progress::watch(const string& _name, const function<size_t()>& _size, const size_t& _capacity)
+{
+	lock_guard<mutex> lk(this->lock);
+	this->queues.push_back({ _name, _size, _capacity });
+}
+
+/// forget the queues, before they are destroyed
+void Progress::unwatch()
+{
+	lock_guard<mutex> lk(this->lock);
+	this->queues.clear();
+}
+
+/// monitor thread: an update every interval seconds until stop()
+void Progress::loop()
+{
+	unique_lock<mutex> lk(this->lock);
+
+	while (this->running)
+	{
+		if (this->wake.wait_for(lk, chrono::seconds(this->interval), [this] { return !this->running; }))
+			break;
+
+		lk.unlock();
+		update(STATUS_RUNNING);
+		lk.lock();
+	}
+}
+
+/**
+* Print the progress line and replace status.json
+*
+* Current fps is measured since the previous update, the ETA uses the average fps.
+*
+* @param _state (string): STATUS_*
+*/
+void Progress::update(const string& _state)
+{
+	const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	const long done = this->frames();
+	const double elapsed = chrono::duration<double>(now - this->start_time).count();
+	const double dt = chrono::duration<double>(now - this->last_time).count();
+	const double fps_avg = elapsed > 0.0 ? done / elapsed : 0.0;
+	const double fps_now = dt > 0.0 ? (done - this->last_frames) / dt : 0.0;
+	const long left = max(0L, this->total - done);
+	const double eta = fps_avg > 0.0 ? left / fps_avg : -1.0;
+	const double rss = Progress::getRSS();
+
+	this->last_time = now;
+	this->last_frames = done;
+
+	json status = json::object();
+	status["video"] = this->name;
+	status["state"] = _state;
+	status["frames"] = done;
+	status["frames_total"] = this->total;
+	status["fps"] = fps_now;
+	status["fps_avg"] = fps_avg;
+	status["elapsed_s"] = elapsed;
+	status["eta_s"] = eta;
+	status["rss_mb"] = rss;
+	status["updated"] = static_cast<long long>(time(nullptr));
+	status["queues"] = json::object();
+
+	// one string, one write: lines of parallel videos do not mix
+	ostringstream line;
+	line << fixed << setprecision(1) << "DEBUG::progress " << this->name << ": " << done << "/" << this->total
+		<< " (" << (this->total > 0 ? 100.0 * done / this->total : 100.0) << "%), " << fps_now << " fps (avg " << fps_avg << ")";
+	if (eta >= 0.0)
+		line << ", ETA " << static_cast<long>(eta) / 3600 << "h" << setfill('0') << setw(2) << (static_cast<long>(eta) / 60) % 60
+			<< "m" << setw(2) << static_cast<long>(eta) % 60 << "s" << setfill(' ');
+
+	{
+		lock_guard<mutex> lk(this->lock);
+		for (size_t i = 0; i < this->queues.size(); i++)
+		{
+			size_t depth = this->queues[i].size();
+			status["queues"][this->queues[i].name] = { { "depth", depth }, { "capacity", this->queues[i].capacity } };
+			line << (i == 0 ? ", queues " : " ") << this->queues[i].name << " " << depth << "/" << this->queues[i].capacity;
+		}
+	}
+
+	line << ", rss " << rss << " MB";
+	if (_state.compare(STATUS_RUNNING) != 0)
+		line << " [" << _state << "]";
+	line << "\n";
+	cout << line.str() << flush;
+
+	try
+	{
+		string tmp_path = this->status_path + ".tmp";
+		{
+			ofstream tmp(filesystem::u8path(tmp_path), ios_base::trunc);
+			tmp << status.dump(1, '\t') << endl;
+		}
+		filesystem::rename(filesystem::u8path(tmp_path), filesystem::u8path(this->status_path));
+	}
+	catch (const exception& msg)
+	{
+		cout << "WARNING::cannot write " << STATUS_FILE << ": " << msg.what() << endl;
+	}
+}
+
+/**
+* Resident memory of the process
+*
+* @return (double) MB, 0 if not available on this platform
+*/
+double Progress::getRSS()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return pmc.WorkingSetSize / (1024.0 * 1024.0);
+#elif defined(__linux__)
+	long pages = 0, resident = 0;
+	ifstream statm("/proc/self/statm");
+	if (statm >> pages >> resident)
+		return resident * static_cast<double>(sysconf(_SC_PAGESIZE)) / (1024.0 * 1024.0);
+#endif
+	return 0.0;
+}
@@ -0,0 +1,89 @@
+#ifndef __PROGRESS_H__
+#define __PROGRESS_H__
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+
+#include "json.hpp"
+
+#if defined(_WIN32)
+	#include <windows.h>
+	#include <psapi.h>		// GetProcessMemoryInfo (link psapi)
+#elif defined(__unix__) || defined(__APPLE__)
+	#include <unistd.h>		// sysconf
+#endif
+
+#define STATUS_FILE "status.json"
+#define STATUS_RUNNING "running"
+#define STATUS_DONE "done"
+#define STATUS_STOPPED "stopped"
+
+using namespace std;
+using json = nlohmann::json;
+
+// a queue of the pipeline, sampled by the monitor
+typedef struct
+{
+	string name;
+	function<size_t()> size;
+	size_t capacity;
+}Tqueueprobe;
+
+/**
+* Progress monitor of a video
+*
+* A thread wakes up every few seconds, prints a progress line (frames written out of the
+* frames to write, current and average fps, ETA, queue depths, resident memory) and replaces
+* <name>_meta/status.json atomically with the same values, so that a job orchestrator can
+* detect stalled runs without parsing the output. The monitor only reads counters the
+* pipeline keeps anyway: it does not slow the processing down.
+*/
+class Progress
+{
+private:
+	string name;
+	string status_path;
+	int interval;					// seconds
+	long total;						// frames to write
+	function<long()> frames;		// frames written so far
+	vector<Tqueueprobe> queues;
+	chrono::steady_clock::time_point start_time;
+	chrono::steady_clock::time_point last_time;
+	long last_frames;
+
+	thread monitor;
+	mutex lock;
+	condition_variable wake;
+	bool running;
+
+	void loop();
+	void update(const string& _state);
+
+public:
+	// Constructors
+	Progress();
+	~Progress();
+
+	Progress(const Progress&) = delete;
+	Progress& operator=(const Progress&) = delete;
+
+	// methods
+	void start(const string& _name, const string& _meta_dir, const int& _interval, const long& _total, const function<long()>& _frames);
+	void stop(const string& _state);
+	void watch(const string& _name, const function<size_t()>& _size, const size_t& _capacity);
+	void unwatch();
+	static double getRSS();
+};
+
+#endif
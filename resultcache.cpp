@@ -0,0 +1,209 @@
+#include "resultcache.hpp"
+
+Resultcache::Resultcache(const string& _cache_dir)
+{
+	this->dir = _cache_dir;
+
+	if (!this->dir.empty())
+		filesystem::create_directories(filesystem::u8path(this->dir));
+}
+
+bool Resultcache::isEnabled() const
+{
+	return !this->dir.empty();
+}
+
+/**
+* Key of a metric result
+*
+* @param _content_hash (uint64_t): see hashContent
+* @param _feature_name (string): the metric
+* @param _params (json): everything the metric results depend on, besides the video
+* @return (string) 16 hex digits
+*/
+string Resultcache::getKey(const uint64_t& _content_hash, const string& _feature_name, const json& _params) const
+{
+	string desc = to_string(CACHE_VERSION) + "|" + _feature_name + "|" + _params.dump();
+	uint64_t h = Resultcache::hashBytes(desc.data(), desc.size(), _content_hash);
+
+	char hex[17];
+	snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(h));
+	return string(hex);
+}
+
+/**
+* Put a cached result in the output directory
+*
+* @param _key (string): see getKey
+* @param _meta_dir (string): the <name>_meta directory of the video
+* @param _feature_name (string): the metric
+* @param _output_format (string): csv, columns or both
+* @return (bool) false if the entry does not hold every requested format (nothing is placed)
+*/
+bool Resultcache::restore(const string& _key, const string& _meta_dir, const string& _feature_name, const string& _output_format) const
+{
+	if (!this->isEnabled())
+		return false;
+
+	filesystem::path entry = filesystem::u8path(this->dir) / _key;
+	vector<string> items = Resultcache::getItems(_feature_name, _output_format);
+
+	for (size_t i = 0; i < items.size(); i++)
+		if (!filesystem::exists(entry / items[i]))
+			return false;
+
+	for (size_t i = 0; i < items.size(); i++)
+		if (!Resultcache::placeItem(entry / items[i], filesystem::u8path(_meta_dir) / items[i]))
+			return false;
+
+	return true;
+}
+
+/**
+* Add the result of a metric to the cache (formats already in the entry are kept)
+*
+* @param _key (string): see getKey
+* @param _meta_dir (string): the <name>_meta directory of the video, with closed outputs
+* @param _feature_name (string): the metric
+* @param _output_format (string): csv, columns or both
+*/
+void Resultcache::store(const string& _key, const string& _meta_dir, const string& _feature_name, const string& _output_format) const
+{
+	if (!this->isEnabled())
+		return;
+
+	filesystem::path entry = filesystem::u8path(this->dir) / _key;
+	vector<string> items = Resultcache::getItems(_feature_name, _output_format);
+	filesystem::create_directories(entry);
+
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		filesystem::path dst = entry / items[i];
+		filesystem::path tmp = entry / (items[i] + ".tmp");
+		error_code ec;
+
+		if (filesystem::exists(dst))
+			continue;
+
+		// place under a temporary name, then rename: readers never see a partial entry
+		if (Resultcache::placeItem(filesystem::u8path(_meta_dir) / items[i], tmp))
+			filesystem::rename(tmp, dst, ec);
+
+		if (ec)
+			filesystem::remove_all(tmp, ec);
+	}
+}
+
+/**
+* Hard-link (or copy) a file, or a directory of files, replacing the destination
+*
+* @param _src (filesystem::path): file or directory
+* @param _dst (filesystem::path): destination
+* @return (bool) false on error
+*/
+bool Resultcache::placeItem(const filesystem::path& _src, const filesystem::path& _dst)
+{
+	error_code ec;
+	filesystem::remove_all(_dst, ec);
+
+	if (filesystem::is_directory(_src))
+	{
+		filesystem::create_directories(_dst, ec);
+		for (const filesystem::directory_entry& entry : filesystem::directory_iterator(_src))
+			if (!Resultcache::placeItem(entry.path(), _dst / entry.path().filename()))
+				return false;
+
+		return !ec;
+	}
+
+	filesystem::create_hard_link(_src, _dst, ec);
+	if (ec)
+	{
+		ec.clear();
+		filesystem::copy_file(_src, _dst, ec);
+	}
+
+	return !ec;
+}
+
+/// files and directories of a metric in a format
+vector<string> Resultcache::getItems(const string& _feature_name, const string& _output_format)
+{
+	vector<string> items;
+
+	if (_output_format.compare(OUTPUT_COLUMNS) != 0)
+		items.push_back(_feature_name + ".csv");
+	if (_output_format.compare(OUTPUT_CSV) != 0)
+		items.push_back(_feature_name + ".cols");
+
+	return items;
+}
+
+/**
+* Fast content hash of a video
+*
+* Size, modification time and CACHE_HASH_BLOCKS blocks evenly spaced in the file: a changed
+* file almost always changes size, time or the sampled bytes, and reading ~1 MB is cheap.
+*
+* @param _video_path (string): the video
+* @return (uint64_t) the hash
+*/
+uint64_t Resultcache::hashContent(const string& _video_path)
+{
+	filesystem::path path = filesystem::u8path(_video_path);
+	uint64_t size = static_cast<uint64_t>(filesystem::file_size(path));
+	int64_t mtime = static_cast<int64_t>(filesystem::last_write_time(path).time_since_epoch().count());
+
+	uint64_t h = Resultcache::hashBytes(&size, sizeof(size), 0);
+	h = Resultcache::hashBytes(&mtime, sizeof(mtime), h);
+
+	ifstream file(path, ios_base::binary);
+	vector<char> block(CACHE_HASH_BLOCK);
+	uint64_t last = size > CACHE_HASH_BLOCK ? size - CACHE_HASH_BLOCK : 0;
+
+	for (int i = 0; i < CACHE_HASH_BLOCKS; i++)
+	{
+		uint64_t offset = last * i / (CACHE_HASH_BLOCKS - 1);
+		file.seekg(static_cast<streamoff>(offset));
+		file.read(block.data(), block.size());
+		h = Resultcache::hashBytes(block.data(), static_cast<size_t>(file.gcount()), h);
+		file.clear();
+	}
+
+	return h;
+}
+
+/**
+* 64-bit hash of a buffer (FNV-1a on 8-byte words, murmur3 finalizer)
+*
+* @param _data (void*): bytes
+* @param _n (size_t): number of bytes
+* @param _seed (uint64_t): previous hash, to chain buffers
+* @return (uint64_t) the hash
+*/
+uint64_t Resultcache::hashBytes(const void* _data, const size_t& _n, const uint64_t& _seed)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(_data);
+	uint64_t h = 0xcbf29ce484222325ULL ^ _seed;
+	size_t i = 0;
+
+	for (; i + 8 <= _n; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, p + i, 8);
+		h = (h ^ word) * 0x100000001b3ULL;
+		h ^= h >> 29;
+	}
+
+	for (; i < _n; i++)
+		h = (h ^ p[i]) * 0x100000001b3ULL;
+
+	h ^= _n;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	return h;
+}
@@ -0,0 +1,58 @@
+#ifndef __RESULTCACHE_H__
+#define __RESULTCACHE_H__
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include "json.hpp"
+#include "generica.hpp"
+
+#define CACHE_VERSION 1				// bump when a metric changes its results
+#define CACHE_HASH_BLOCKS 16		// blocks of the video read for the content hash...
+#define CACHE_HASH_BLOCK 65536		// ...of this many bytes, evenly spaced (first and last included)
+
+using namespace std;
+using json = nlohmann::json;
+
+/**
+* Content-addressed cache of metric results
+*
+* An entry is the output of one metric (<feature>.csv and/or <feature>.cols) for one video
+* content and one set of parameters. Its key hashes:
+* - the content of the video: size, modification time and a few sampled blocks, so that a
+*   multi-GB file is keyed in a couple of milliseconds
+* - the metric name and the parameters that metric depends on (e.g. roi and patches for blur)
+* so that each metric is looked up on its own: enabling motion does not recompute blur.
+* Entries are hard-linked into place (copied if the file system cannot link); outputs are
+* always deleted, never truncated, before being rewritten, so a link never alters an entry.
+*/
+class Resultcache
+{
+private:
+	string dir;					// empty: cache disabled
+
+	static bool placeItem(const filesystem::path& _src, const filesystem::path& _dst);
+	static vector<string> getItems(const string& _feature_name, const string& _output_format);
+
+public:
+	// Constructors
+	Resultcache(const string& _cache_dir);
+
+	// methods
+	bool isEnabled() const;
+	string getKey(const uint64_t& _content_hash, const string& _feature_name, const json& _params) const;
+	bool restore(const string& _key, const string& _meta_dir, const string& _feature_name, const string& _output_format) const;
+	void store(const string& _key, const string& _meta_dir, const string& _feature_name, const string& _output_format) const;
+
+	// methods::hash
+	static uint64_t hashContent(const string& _video_path);
+	static uint64_t hashBytes(const void* _data, const size_t& _n, const uint64_t& _seed);
+};
+
+#endif
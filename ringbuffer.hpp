@@ -0,0 +1,92 @@
+#ifndef __RINGBUFFER_H__
+#define __RINGBUFFER_H__
+
+#include <vector>
+#include <stdexcept>
+
+using namespace std;
+
+/**
+* Fixed-capacity ring buffer
+*
+* All the slots are constructed once. push() does not copy or move anything: it advances the
+* head and hands back the oldest slot, so that the caller can overwrite it in place and its
+* storage (e.g. cv::Mat buffers) is recycled. Template methods must be in the header.
+*
+* @see [SO_1](https://stackoverflow.com/a/972197)
+* @see [SO_2](https://stackoverflow.com/questions/495021/why-can-templates-only-be-implemented-in-the-header-file)
+*/
+template <typename T>
+class Ringbuffer
+{
+private:
+	vector<T> slots;
+	size_t head;		// index of the newest element
+	size_t filled;		// number of pushed elements, up to capacity
+
+public:
+	// Constructors
+	Ringbuffer(const size_t& _capacity)
+	{
+		if (_capacity == 0)
+			throw invalid_argument("Ringbuffer capacity must be > 0");
+
+		this->slots = vector<T>(_capacity);
+		this->head = _capacity - 1;
+		this->filled = 0;
+	}
+
+	/**
+	* Slot that the next push() will return
+	*
+	* It is the oldest element (or an unused slot): fill it in place, then push().
+	* If filling fails, just do not push.
+	*/
+	T& next()
+	{
+		return this->slots[(this->head + 1) % this->slots.size()];
+	}
+
+	/// make next() the newest element, in O(1)
+	T& push()
+	{
+		this->head = (this->head + 1) % this->slots.size();
+		if (this->filled < this->slots.size())
+			this->filled += 1;
+
+		return this->slots[this->head];
+	}
+
+	/// newest element
+	T& back()
+	{
+		return this->slots[this->head];
+	}
+
+	/**
+	* Element pushed _k steps before the newest one
+	*
+	* prev(0) is back(). Slots never pushed hold default constructed elements.
+	*
+	* @param _k (size_t): 0 <= _k < capacity
+	*/
+	T& prev(const size_t& _k)
+	{
+		if (_k >= this->slots.size())
+			throw out_of_range("Ringbuffer::prev beyond capacity");
+
+		return this->slots[(this->head + this->slots.size() - _k) % this->slots.size()];
+	}
+
+	size_t size() const
+	{
+		return this->filled;
+	}
+
+	size_t capacity() const
+	{
+		return this->slots.size();
+	}
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "sampler.hpp"
+
+Sampler::Sampler()
+{
+	this->mode = SAMPLE_ALL;
+	this->stride = 1;
+	this->rate = 0.0;
+	this->ratio = 1.0;
+	this->seed = 0;
+	this->video_fps = 0.0;
+}
+
+/**
+* Configure from settings
+*
+* @param _args (Targuments): parsed settings
+* @param _video_fps (double): frame rate of the video (not rounded)
+*/
+void Sampler::setup(const Targuments& _args, const double& _video_fps)
+{
+	this->mode = _args.sampling;
+	this->stride = _args.sample_stride;
+	this->rate = _args.sample_fps;
+	this->ratio = _args.sample_ratio;
+	this->seed = static_cast<uint64_t>(_args.sample_seed);
+	this->video_fps = _video_fps;
+
+	// the video is not faster than the requested rate: every frame
+	if (this->mode.compare(SAMPLE_FPS) == 0 && (this->video_fps <= 0.0 || this->rate >= this->video_fps))
+		this->mode = SAMPLE_ALL;
+}
+
+/**
+* Keyframe indices, for keyframe sampling
+*
+* @param _keyframes (vector<int>): sorted frame numbers of the keyframes
+*/
+void Sampler::setKeyframes(const vector<int>& _keyframes)
+{
+	this->keyframes = _keyframes;
+}
+
+/**
+* Is the frame in the sample
+*
+* @param _frame_n (int): frame number
+* @return (bool) true if the frame is analyzed and written
+*/
+bool Sampler::keep(const int& _frame_n) const
+{
+	if (_frame_n < 0)
+		return false;
+
+	if (this->mode.compare(SAMPLE_STRIDE) == 0)
+		return _frame_n % this->stride == 0;
+
+	if (this->mode.compare(SAMPLE_FPS) == 0)
+	{
+		// first frame of each 1/rate-second slot of media time
+		return _frame_n == 0 || floor(_frame_n * this->rate / this->video_fps) > floor((_frame_n - 1) * this->rate / this->video_fps);
+	}
+
+	if (this->mode.compare(SAMPLE_KEYFRAMES) == 0)
+		return binary_search(this->keyframes.begin(), this->keyframes.end(), _frame_n);
+
+	if (this->mode.compare(SAMPLE_RANDOM) == 0)
+	{
+		// splitmix64 of (seed, frame number): uniform in [0, 1)
+		uint64_t z = this->seed + 0x9e3779b97f4a7c15ULL * (static_cast<uint64_t>(_frame_n) + 1);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		z ^= z >> 31;
+
+		return static_cast<double>(z >> 11) * 0x1.0p-53 < this->ratio;
+	}
+
+	return true;
+}
+
+/**
+* What to do with a frame
+*
+* @param _frame_n (int): frame number
+* @param _motion (bool): motion enabled (needs the frame before each sampled one)
+* @return (int) FRAME_SKIP, FRAME_SEED or FRAME_KEEP
+*/
+int Sampler::classify(const int& _frame_n, const bool& _motion) const
+{
+	if (this->keep(_frame_n))
+		return FRAME_KEEP;
+
+	if (_motion && this->keep(_frame_n + 1))
+		return FRAME_SEED;
+
+	return FRAME_SKIP;
+}
+
+bool Sampler::isAll() const
+{
+	return this->mode.compare(SAMPLE_ALL) == 0;
+}
+
+bool Sampler::isKeyframes() const
+{
+	return this->mode.compare(SAMPLE_KEYFRAMES) == 0;
+}
+
+/// sampling parameters, for the result cache and the checkpoint
+json Sampler::describe() const
+{
+	json d = { { "mode", this->mode } };
+
+	if (this->mode.compare(SAMPLE_STRIDE) == 0)
+		d["stride"] = this->stride;
+	else if (this->mode.compare(SAMPLE_FPS) == 0)
+		d["fps"] = { this->rate, this->video_fps };
+	else if (this->mode.compare(SAMPLE_RANDOM) == 0)
+		d["random"] = { this->ratio, this->seed };
+
+	return d;
+}
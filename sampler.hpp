@@ -0,0 +1,55 @@
+#ifndef __SAMPLER_H__
+#define __SAMPLER_H__
+
+#include <string>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "json.hpp"
+#include "generica.hpp"
+
+// what to do with a frame
+#define FRAME_SKIP 0		// not decoded to an image (grab only)
+#define FRAME_SEED 1		// decoded for the temporal metrics of the next frame, not written
+#define FRAME_KEEP 2		// decoded, analyzed and written
+
+using namespace std;
+using json = nlohmann::json;
+
+/**
+* Frame sampling
+*
+* The decision depends on the frame number only (random sampling hashes it with the seed),
+* so that segments, resumed runs and the serial loop sample the same frames.
+* Motion is the motion between a frame and the one before it: when that one is not sampled,
+* it is decoded anyway as a seed, so a sampled value equals the one of a full run.
+* Keyframe sampling needs the keyframe indices of the video (setKeyframes).
+*/
+class Sampler
+{
+private:
+	string mode;
+	int stride;
+	double rate;			// frames per second of media time
+	double ratio;			// random: fraction of frames
+	uint64_t seed;
+	double video_fps;
+	vector<int> keyframes;	// sorted
+
+public:
+	// Constructors
+	Sampler();
+
+	// methods
+	void setup(const Targuments& _args, const double& _video_fps);
+	void setKeyframes(const vector<int>& _keyframes);
+	bool keep(const int& _frame_n) const;
+	int classify(const int& _frame_n, const bool& _motion) const;
+	bool isAll() const;
+	bool isKeyframes() const;
+	json describe() const;
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include "scheduler.hpp"
+
+thread_local int Scheduler::self = -1;
+
+Scheduler::Scheduler(const int& _n_threads)
+{
+	int n = max(1, _n_threads);
+
+	this->pending = 0;
+	this->next_queue = 0;
+	this->quit = false;
+	this->queued = 0;
+
+	for (int i = 0; i < n; i++)
+		this->queues.push_back(make_unique<Tqueue>());
+
+	for (int i = 0; i < n; i++)
+		this->threads.push_back(thread(&Scheduler::workerLoop, this, i));
+}
+
+Scheduler::~Scheduler()
+{
+	{
+		lock_guard<mutex> lk(this->idle_lock);
+		this->quit = true;
+	}
+	this->idle_cv.notify_all();
+
+	for (size_t i = 0; i < this->threads.size(); i++)
+		this->threads[i].join();
+}
+
+/**
+* Add a job
+*
+* @param _job (function): the job, it must not throw
+*/
+void Scheduler::submit(function<void()> _job)
+{
+	int index = Scheduler::self;
+	if (index < 0)
+		index = static_cast<int>(this->next_queue++ % this->queues.size());
+
+	this->pending++;
+	{
+		lock_guard<mutex> lk(this->queues[index]->lock);
+		this->queues[index]->jobs.push_back(move(_job));
+	}
+
+	// counted under the lock: an idle thread either sees the job or gets the notification
+	lock_guard<mutex> lk(this->idle_lock);
+	this->queued++;
+	this->idle_cv.notify_all();
+}
+
+/// block until every job, including the ones submitted by jobs, is done
+void Scheduler::wait()
+{
+	unique_lock<mutex> lk(this->idle_lock);
+	this->idle_cv.wait(lk, [this] { return this->pending == 0; });
+}
+
+int Scheduler::size() const
+{
+	return static_cast<int>(this->threads.size());
+}
+
+/**
+* Next job for a thread: its own newest, otherwise the oldest of another thread
+*
+* @param _index (int): the thread
+* @param _job (function): the job found
+* @return (bool) false if every deque is empty
+*/
+bool Scheduler::takeJob(const int& _index, function<void()>& _job)
+{
+	{
+		lock_guard<mutex> lk(this->queues[_index]->lock);
+		if (!this->queues[_index]->jobs.empty())
+		{
+			_job = move(this->queues[_index]->jobs.back());
+			this->queues[_index]->jobs.pop_back();
+			return true;
+		}
+	}
+
+	const int n = static_cast<int>(this->queues.size());
+	for (int k = 1; k < n; k++)
+	{
+		Tqueue& victim = *this->queues[(_index + k) % n];
+		lock_guard<mutex> lk(victim.lock);
+		if (!victim.jobs.empty())
+		{
+			_job = move(victim.jobs.front());
+			victim.jobs.pop_front();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void Scheduler::workerLoop(const int& _index)
+{
+	Scheduler::self = _index;
+	function<void()> job;
+
+	while (true)
+	{
+		if (this->takeJob(_index, job))
+		{
+			{
+				lock_guard<mutex> lk(this->idle_lock);
+				this->queued--;
+			}
+
+			try
+			{
+				job();
+			}
+			catch (const exception& msg)
+			{
+				cerr << "ERR::" << msg.what() << endl;
+				exit(-1);
+			}
+
+			job = nullptr;
+			if (--this->pending == 0)
+			{
+				lock_guard<mutex> lk(this->idle_lock);
+				this->idle_cv.notify_all();
+			}
+
+			continue;
+		}
+
+		// idle until a job is queued: one pushed after takeJob failed is already counted
+		unique_lock<mutex> lk(this->idle_lock);
+		this->idle_cv.wait(lk, [this] { return this->quit || this->queued > 0; });
+
+		if (this->quit && this->queued <= 0)
+			return;
+	}
+}
@@ -0,0 +1,63 @@
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+using namespace std;
+
+/**
+* Work-stealing thread pool
+*
+* Every thread owns a deque of jobs: it takes its own jobs from the back (the most recent,
+* whose data is still warm) and, when it has none, steals from the front of the others'
+* (the oldest, usually the largest pieces of work). Jobs may submit jobs: from a pool
+* thread they go to its own deque, from outside they are spread round robin.
+* Jobs are coarse (a video, a segment), so each deque is guarded by its own mutex.
+*/
+class Scheduler
+{
+private:
+	typedef struct
+	{
+		mutex lock;
+		deque<function<void()>> jobs;
+	}Tqueue;
+
+	vector<unique_ptr<Tqueue>> queues;
+	vector<thread> threads;
+	atomic<long> pending;			// submitted and not finished
+	atomic<unsigned> next_queue;	// round robin for external submits
+	atomic<bool> quit;
+	mutex idle_lock;
+	condition_variable idle_cv;		// new jobs, or all jobs done
+	long queued;					// jobs in the deques, guarded by idle_lock (below 0 while a taken job is not counted yet)
+
+	static thread_local int self;	// index of the pool thread running the caller, -1 outside
+
+	void workerLoop(const int& _index);
+	bool takeJob(const int& _index, function<void()>& _job);
+
+public:
+	// Constructors
+	Scheduler(const int& _n_threads);
+	~Scheduler();
+
+	Scheduler(const Scheduler&) = delete;
+	Scheduler& operator=(const Scheduler&) = delete;
+
+	// methods
+	void submit(function<void()> _job);
+	void wait();
+	int size() const;
+};
+
+#endif
@@ -0,0 +1,248 @@
+#include "synthsource.hpp"
+
+Synthsource::Synthsource()
+{
+	this->width = 0;
+	this->height = 0;
+	this->frames = 0;
+	this->gop = 1;
+	this->fps = 0.0;
+	this->pattern = SYNTH_PATTERN_TEXTURE;
+	this->velocity[0] = this->velocity[1] = 0.0;
+	this->blur_sigma[0] = this->blur_sigma[1] = 0.0;
+	this->exposure[0] = this->exposure[1] = 1.0;
+	this->noise = 0.0;
+	this->seed = 0;
+	this->position = -1;
+}
+
+/**
+* Read the description and prepare the pattern
+*
+* @param _filename (string): full path to the .synth file
+* @return (bool) false if the file cannot be read or a value is not valid
+*/
+bool Synthsource::open(const string& _filename)
+{
+	release();
+
+	try
+	{
+		ifstream file(_filename);
+		json j;
+		file >> j;
+
+		this->width = j.value("width", 1280);
+		this->height = j.value("height", 720);
+		this->fps = j.value("fps", 30.0);
+		this->frames = j.value("frames", 300);
+		this->gop = j.value("gop", static_cast<int>(ceil(this->fps)));
+		this->pattern = j.value("pattern", string(SYNTH_PATTERN_TEXTURE));
+		this->noise = j.value("noise", 0.0);
+		this->seed = j.value("seed", 0);
+
+		vector<double> v = j.value("velocity", vector<double>{ 0.0, 0.0 });
+		vector<double> b = j.value("blur_sigma", vector<double>{ 0.0, 0.0 });
+		vector<double> e = j.value("exposure", vector<double>{ 1.0, 1.0 });
+
+		if (v.size() != 2 || b.size() != 2 || e.size() != 2)
+			throw runtime_error("velocity, blur_sigma and exposure must have 2 elements");
+		if (this->width < 1 || this->height < 1 || this->frames < 1 || !(this->fps > 0.0) || this->gop < 1)
+			throw runtime_error("width, height, frames, fps and gop must be positive");
+		if (b[0] < 0.0 || b[1] < 0.0 || e[0] < 0.0 || e[1] < 0.0 || this->noise < 0.0)
+			throw runtime_error("blur_sigma, exposure and noise cannot be negative");
+		if (this->pattern.compare(SYNTH_PATTERN_TEXTURE) != 0 && this->pattern.compare(SYNTH_PATTERN_CHECKER) != 0)
+			throw runtime_error("pattern must be " SYNTH_PATTERN_TEXTURE " or " SYNTH_PATTERN_CHECKER);
+
+		for (int i = 0; i < 2; i++)
+		{
+			this->velocity[i] = v[i];
+			this->blur_sigma[i] = b[i];
+			this->exposure[i] = e[i];
+		}
+	}
+	catch (const exception& msg)
+	{
+		cerr << "ERR::" << _filename << ": " << msg.what() << endl;
+		return false;
+	}
+
+	// one tile of the pattern, periodic so that it can be tiled and moved without seams
+	cv::Mat tile(SYNTH_TILE, SYNTH_TILE, CV_8UC3);
+
+	if (this->pattern.compare(SYNTH_PATTERN_CHECKER) == 0)
+	{
+		for (int y = 0; y < SYNTH_TILE; y++)
+			for (int x = 0; x < SYNTH_TILE; x++)
+				tile.at<cv::Vec3b>(y, x) = cv::Vec3b::all(((x / SYNTH_SQUARE + y / SYNTH_SQUARE) % 2) * 255);
+	}
+	else
+	{
+		// smooth the tile among its copies, then stretch the contrast back
+		cv::Mat tiles;
+		cv::RNG rng(static_cast<uint64>(this->seed));
+		rng.fill(tile, cv::RNG::UNIFORM, 0, 256);
+		cv::repeat(tile, 3, 3, tiles);
+		cv::GaussianBlur(tiles, tiles, cv::Size(0, 0), 2.0);
+		tiles(cv::Rect(SYNTH_TILE, SYNTH_TILE, SYNTH_TILE, SYNTH_TILE)).copyTo(tile);
+		cv::normalize(tile, tile, 0, 255, cv::NORM_MINMAX);
+	}
+
+	const int nx = (this->width + 2 * SYNTH_TILE - 1) / SYNTH_TILE, ny = (this->height + 2 * SYNTH_TILE - 1) / SYNTH_TILE;
+	cv::repeat(tile, ny, nx, this->canvas);
+	this->position = 0;
+
+	return true;
+}
+
+bool Synthsource::isOpened() const
+{
+	return this->position >= 0;
+}
+
+/**
+* Generate the next frame
+*
+* @param _bgr (cv::Mat): output image, BGR (as cv::VideoCapture)
+* @return (bool) false at the end of the video
+*/
+bool Synthsource::read(cv::Mat& _bgr)
+{
+	if (this->position < 0 || this->position >= this->frames)
+		return false;
+
+	render(this->position, _bgr);
+	this->position += 1;
+	return true;
+}
+
+/**
+* Skip the next frame
+*
+* @return (bool) false at the end of the video
+*/
+bool Synthsource::grab()
+{
+	if (this->position < 0 || this->position >= this->frames)
+		return false;
+
+	this->position += 1;
+	return true;
+}
+
+/**
+* Move the reader so that read() generates frame _frame_n
+*
+* @param _frame_n (int): frame index
+* @return (bool) false if not open or out of the video
+*/
+bool Synthsource::seek(const int& _frame_n)
+{
+	if (this->position < 0 || _frame_n < 0 || _frame_n > this->frames)
+		return false;
+
+	this->position = _frame_n;
+	return true;
+}
+
+void Synthsource::release()
+{
+	this->canvas.release();
+	this->position = -1;
+}
+
+/**
+* Frame _frame_n
+*
+* The pattern moved by round(n * velocity), blurred, scaled by the exposure gain and with
+* noise added, in this order. The noise only depends on the seed and the frame number.
+*
+* @param _frame_n (int): frame index
+* @param _bgr (cv::Mat): output image, BGR
+*/
+void Synthsource::render(const int& _frame_n, cv::Mat& _bgr) const
+{
+	// the pattern moves by +velocity: the window on the canvas moves by -velocity
+	int ox = static_cast<int>(-lround(_frame_n * this->velocity[0]) % SYNTH_TILE);
+	int oy = static_cast<int>(-lround(_frame_n * this->velocity[1]) % SYNTH_TILE);
+	ox = ox < 0 ? ox + SYNTH_TILE : ox;
+	oy = oy < 0 ? oy + SYNTH_TILE : oy;
+
+	this->canvas(cv::Rect(ox, oy, this->width, this->height)).copyTo(_bgr);
+
+	double sigma = ramp(this->blur_sigma, _frame_n);
+	if (sigma > 0.0)
+		cv::GaussianBlur(_bgr, _bgr, cv::Size(0, 0), sigma);
+
+	double gain = ramp(this->exposure, _frame_n);
+	if (gain != 1.0)
+		_bgr.convertTo(_bgr, -1, gain, 0.0);
+
+	if (this->noise > 0.0)
+	{
+		cv::Mat noise_mat(this->height, this->width, CV_16SC3);
+		cv::RNG rng((static_cast<uint64>(this->seed) << 32) ^ static_cast<uint64>(_frame_n + 1));
+		rng.fill(noise_mat, cv::RNG::NORMAL, 0.0, this->noise);
+		cv::add(_bgr, noise_mat, _bgr, cv::noArray(), CV_8U);
+	}
+}
+
+/**
+* Property of the video, as cv::VideoCapture::get
+*
+* @param _prop (int): CAP_PROP_FRAME_WIDTH, _HEIGHT, _FPS, _FRAME_COUNT, _POS_FRAMES or _POS_MSEC
+* @return (double) the value, 0 for other properties
+*/
+double Synthsource::get(const int& _prop) const
+{
+	switch (_prop)
+	{
+	case cv::CAP_PROP_FRAME_WIDTH:
+		return this->width;
+	case cv::CAP_PROP_FRAME_HEIGHT:
+		return this->height;
+	case cv::CAP_PROP_FPS:
+		return this->fps;
+	case cv::CAP_PROP_FRAME_COUNT:
+		return this->frames;
+	case cv::CAP_PROP_POS_FRAMES:
+		return max(0, this->position);
+	case cv::CAP_PROP_POS_MSEC:
+		return max(0, this->position - 1) * 1000.0 / this->fps;		// the frame just read
+	default:
+		return 0.0;
+	}
+}
+
+/// keyframes: one every gop frames
+vector<int> Synthsource::getKeyframes() const
+{
+	vector<int> keyframes;
+	for (int i = 0; i < this->frames; i += this->gop)
+		keyframes.push_back(i);
+
+	return keyframes;
+}
+
+/// linear ramp from _range[0] at the first frame to _range[1] at the last one
+double Synthsource::ramp(const double _range[], const int& _frame_n) const
+{
+	if (this->frames < 2)
+		return _range[0];
+
+	return _range[0] + (_range[1] - _range[0]) * _frame_n / (this->frames - 1);
+}
+
+/**
+* Is the file a synthetic video
+*
+* @param _filename (string): the file
+* @return (bool) true if the extension is SYNTH_EXTENSION (case insensitive)
+*/
+bool Synthsource::isSynthetic(const string& _filename)
+{
+	string ext = filesystem::u8path(_filename).extension().string();
+	transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return tolower(c); });
+
+	return ext.compare(SYNTH_EXTENSION) == 0;
+}
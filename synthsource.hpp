@@ -0,0 +1,71 @@
+#ifndef __SYNTHSOURCE_H__
+#define __SYNTHSOURCE_H__
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>		// GaussianBlur
+#include <opencv2/videoio.hpp>		// CAP_PROP_*
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "json.hpp"
+#include "generica.hpp"
+
+#define SYNTH_EXTENSION ".synth"
+#define SYNTH_PATTERN_TEXTURE "texture"		// smoothed uniform noise: corners and edges at every scale
+#define SYNTH_PATTERN_CHECKER "checker"		// black and white squares of SYNTH_SQUARE pixels
+#define SYNTH_TILE 256						// the pattern repeats every SYNTH_TILE pixels
+#define SYNTH_SQUARE 32
+
+using namespace std;
+using json = nlohmann::json;
+
+/**
+* Synthetic video
+*
+* A .synth file is a JSON description of a video instead of a video: the frames are generated
+* on read, with known properties, so that throughput and metric accuracy can be measured with
+* no input video and no decoder in the loop. Every field is optional:
+* - width, height, fps, frames: shape of the video (1280, 720, 30, 300)
+* - pattern: texture or checker (texture)
+* - velocity: [dx, dy] displacement of the pattern in pixels per frame (rounded per frame)
+* - blur_sigma: [first, last] sigma of the Gaussian blur, linear over the video (0 = sharp)
+* - exposure: [first, last] gain of the pixel values, linear over the video (1 = unchanged)
+* - noise: sigma of additive Gaussian noise, in grey levels
+* - gop: distance between keyframes, for segments and keyframe sampling (fps)
+* - seed: pattern and noise; frame n is the same whatever the order of the reads
+*/
+class Synthsource
+{
+private:
+	int width, height, frames, gop;
+	double fps;
+	string pattern;
+	double velocity[2];
+	double blur_sigma[2];
+	double exposure[2];
+	double noise;
+	int seed;
+	cv::Mat canvas;		// pattern tiled over (width + SYNTH_TILE) x (height + SYNTH_TILE)
+	int position;		// next frame to read, -1 if not open
+
+	double ramp(const double _range[], const int& _frame_n) const;
+
+public:
+	// Constructors
+	Synthsource();
+
+	// methods
+	bool open(const string& _filename);
+	bool isOpened() const;
+	bool read(cv::Mat& _bgr);
+	bool grab();
+	bool seek(const int& _frame_n);
+	void release();
+	void render(const int& _frame_n, cv::Mat& _bgr) const;
+	double get(const int& _prop) const;
+	vector<int> getKeyframes() const;
+	static bool isSynthetic(const string& _filename);
+};
+
+#endif
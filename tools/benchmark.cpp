@@ -0,0 +1,205 @@
+// benchmark.cpp : microbenchmark of the Frame metrics on synthetic frames.
+//
+// usage: benchmark [backend] [iterations] [output.json]
+// blur, exposure, entropy, hist and motion run on synthetic BGR frames at 480p, 720p, 1080p
+// and 4K, blur with several patch grids and the histograms with several bin counts. Each case
+// runs BENCH_WARMUP times untimed, then [iterations] times (default BENCH_ITERATIONS); the
+// products cached by Frame (gray plane, histogram, features) are reset before every run, so each
+// one costs as much as a new frame of a video. The report is JSON (stdout without output file):
+// mean ns/frame, variance, min and max, and MB/s of BGR input. Backend: auto (default), cpu, cuda.
+// Build with the toolbox sources it uses (frame.cpp needs perf.cpp for the stage timers, the
+// backends need synthsource.cpp and, when the FFmpeg headers are found, keyframereader.cpp needs
+// the FFmpeg libraries), from tools/:
+// g++ -std=c++17 -O2 -pthread -I.. benchmark.cpp ../frame.cpp ../perf.cpp ../backend.cpp ../cpubackend.cpp
+//     ../cudabackend.cpp ../kernels.cpp ../synthsource.cpp ../keyframereader.cpp ../counters.cpp
+//     $(pkg-config --cflags --libs opencv4) $(pkg-config --libs libavformat libavcodec libswscale libavutil)
+// Without FFmpeg, drop the second pkg-config and add -DUSE_LIBAV=0.
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "../json.hpp"
+#include "../frame.h"
+#include "../backend.hpp"
+#include "../ringbuffer.hpp"
+
+#define BENCH_ITERATIONS 50
+#define BENCH_WARMUP 3
+#define BENCH_SEED 0x5eed
+#define BENCH_SHIFT 4       // displacement (pixels, x and y) between the two frames of motion
+
+using namespace std;
+using json = nlohmann::json;
+
+typedef struct
+{
+	string name;
+	int width, height;
+}Tresolution;
+
+/**
+* Synthetic frame
+*
+* Uniform noise smoothed with a Gaussian (sigma 2): texture at every scale, so that blur has
+* something to measure and motion finds corners to track. The same seed gives the same image.
+*
+* @param _w (int): width
+* @param _h (int): height
+* @param _shift (int): the image is the texture moved by _shift pixels on x and y
+* @return (cv::Mat) BGR image
+*/
+cv::Mat makeImage(const int& _w, const int& _h, const int& _shift)
+{
+	cv::Mat texture(_h + BENCH_SHIFT, _w + BENCH_SHIFT, CV_8UC3);
+	cv::RNG rng(BENCH_SEED);
+
+	rng.fill(texture, cv::RNG::UNIFORM, 0, 256);
+	cv::GaussianBlur(texture, texture, cv::Size(0, 0), 2.0);
+
+	return texture(cv::Rect(_shift, _shift, _w, _h)).clone();
+}
+
+/**
+* Time a case
+*
+* @param _run (function): one run of the case
+* @param _iterations (int): timed runs
+* @param _bytes (double): input bytes of a run, for the throughput
+* @return (json) ns_per_frame (mean), variance_ns2, min_ns, max_ns, mb_per_s
+*/
+template <typename F>
+json measure(F _run, const int& _iterations, const double& _bytes)
+{
+	vector<double> ns(_iterations);
+
+	for (int i = 0; i < BENCH_WARMUP; i++)
+		_run();
+
+	for (int i = 0; i < _iterations; i++)
+	{
+		auto t0 = chrono::steady_clock::now();
+		_run();
+		auto t1 = chrono::steady_clock::now();
+		ns[i] = static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(t1 - t0).count());
+	}
+
+	double mean = 0.0, var = 0.0;
+	for (int i = 0; i < _iterations; i++)
+		mean += ns[i] / _iterations;
+	for (int i = 0; i < _iterations; i++)
+		var += (ns[i] - mean) * (ns[i] - mean) / max(1, _iterations - 1);
+
+	json res = json::object();
+	res["ns_per_frame"] = mean;
+	res["variance_ns2"] = var;
+	res["min_ns"] = *min_element(ns.begin(), ns.end());
+	res["max_ns"] = *max_element(ns.begin(), ns.end());
+	res["mb_per_s"] = mean > 0.0 ? _bytes * 1e3 / mean : 0.0;
+	return res;
+}
+
+/// add a case to the report, and a line to stderr
+void report(json& _results, json _res, const string& _metric, const Tresolution& _resolution, const string& _param)
+{
+	_res["metric"] = _metric;
+	_res["resolution"] = _resolution.name;
+	_res["width"] = _resolution.width;
+	_res["height"] = _resolution.height;
+	_res["param"] = _param;
+
+	cerr << "DEBUG::" << _metric << " " << _resolution.name << " " << _param << ": "
+		<< static_cast<long long>(_res["ns_per_frame"].get<double>()) << " ns/frame, "
+		<< _res["mb_per_s"].get<double>() << " MB/s" << endl;
+
+	_results.push_back(_res);
+}
+
+int main(int argc, char* argv[])
+{
+	string backend_name = argc > 1 ? argv[1] : BACKEND_AUTO;
+	int iterations = argc > 2 ? atoi(argv[2]) : BENCH_ITERATIONS;
+
+	if (iterations < 1)
+	{
+		cerr << "ERR::usage: benchmark [auto|cpu|cuda] [iterations > 0] [output.json]. Quitting..." << endl;
+		exit(-1);
+	}
+
+	cv::Ptr<Backend> be = Backend::create(backend_name, true);
+
+	const Tresolution resolutions[] = { { "480p", 854, 480 }, { "720p", 1280, 720 }, { "1080p", 1920, 1080 }, { "4K", 3840, 2160 } };
+	const int grids[][2] = { { 1, 1 }, { 3, 3 }, { 8, 8 } };
+	const int bins[] = { MIN_BIN_NUMBER, 32, MAX_BIN_NUMBER };
+
+	json results = json::array();
+
+	try
+	{
+		for (const Tresolution& r : resolutions)
+		{
+			const double bytes = static_cast<double>(r.width) * r.height * 3;
+			const double area = static_cast<double>(r.width) * r.height;
+			const cv::Rect roi = cv::Rect(0, 0, r.width, r.height);
+
+			// motion: the previous frame at [0], the last one at [1]
+			Ringbuffer<Frame> buf = Ringbuffer<Frame>(2);
+			be->load(buf.next(), makeImage(r.width, r.height, 0));
+			buf.push();
+			be->load(buf.next(), makeImage(r.width, r.height, BENCH_SHIFT));
+			Frame& frame = buf.push();
+
+			for (const int* g : grids)
+			{
+				int patch_info[4] = { g[0], g[1], r.width / g[0], r.height / g[1] };
+				json res = measure([&]() { frame.reset(1); frame.computeGray(*be); frame.computeBlur(*be, frame, roi, patch_info); }, iterations, bytes);
+				report(results, res, "blur", r, "grid=" + to_string(g[0]) + "x" + to_string(g[1]));
+			}
+
+			for (const int& b : bins)
+			{
+				json res = measure([&]() { frame.reset(1); frame.computeHist(*be, V_CHANNEL, b); }, iterations, bytes);
+				report(results, res, "hist", r, "bins=" + to_string(b));
+
+				res = measure([&]() { frame.reset(1); frame.computeExposure(frame.computeHist(*be, V_CHANNEL, b), area); }, iterations, bytes);
+				report(results, res, "exposure", r, "bins=" + to_string(b));
+
+				res = measure([&]() { frame.reset(1); frame.computeEntropy(frame.computeHist(*be, V_CHANNEL, b), area); }, iterations, bytes);
+				report(results, res, "entropy", r, "bins=" + to_string(b));
+			}
+
+			// includes the features of the previous frame, as a new frame in the writer
+			json res = measure([&]() { Frame& prev = buf.prev(1); prev.reset(0); frame.reset(1); prev.computeFeatures(*be, 0); frame.computeGray(*be); frame.computeMotion(*be, &prev, frame); }, iterations, bytes);
+			report(results, res, "motion", r, "shift=" + to_string(BENCH_SHIFT));
+		}
+	}
+	catch (const exception& msg)
+	{
+		cerr << "ERR::" << msg.what() << endl;
+		exit(-1);
+	}
+
+	json out = json::object();
+	out["backend"] = be->getName();
+	out["opencv"] = CV_VERSION;
+	out["threads"] = cv::getNumThreads();
+	out["iterations"] = iterations;
+	out["warmup"] = BENCH_WARMUP;
+	out["results"] = results;
+
+	if (argc > 3)
+	{
+		ofstream file(argv[3]);
+		file << out.dump(2) << endl;
+	}
+	else
+	{
+		cout << out.dump(2) << endl;
+	}
+
+	return 0;
+}
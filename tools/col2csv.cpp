@@ -0,0 +1,44 @@
+// col2csv.cpp : convert the binary columns of a feature (<feature>.cols) back to CSV.
+//
+// usage: col2csv <video>_meta/<feature>.cols [output.csv]
+// Without output file, the CSV is written to stdout.
+// Build with the toolbox sources it uses, e.g. g++ -std=c++17 -I.. col2csv.cpp ../colreader.cpp
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+
+#include "../colreader.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cerr << "ERR::usage: col2csv <feature>.cols [output.csv]. Quitting..." << endl;
+		exit(-1);
+	}
+
+	try
+	{
+		Colreader reader = Colreader(argv[1]);
+
+		if (argc > 2)
+		{
+			ofstream out(argv[2]);
+			reader.toCSV(out);
+		}
+		else
+		{
+			reader.toCSV(cout);
+		}
+	}
+	catch (const exception& msg)
+	{
+		cerr << "ERR::" << msg.what() << endl;
+		exit(-1);
+	}
+
+	return 0;
+}
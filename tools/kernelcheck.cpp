@@ -0,0 +1,79 @@
+// kernelcheck.cpp : compare the box downscale kernel with cv::resize(INTER_AREA).
+//
+// usage: kernelcheck
+// Kernels::boxDownRows (2x and 4x, 1, 3 and 4 channels) runs on random images whose output
+// widths go from 1 to KCHECK_MAX_COLS pixels, so that every tail of the SIMD loops (16 bytes
+// vertical, 4 BGRA pixels horizontal) is covered, with padded row steps and with black and
+// white images (sums on rounding ties). The output must be equal to cv::resize with INTER_AREA,
+// which the cpu backend uses for the other ratios. Exit code 0 if every case matches.
+// Build once per SIMD flavour (default SSE2, -mavx2), e.g.
+// g++ -std=c++17 -O2 -I.. kernelcheck.cpp ../kernels.cpp $(pkg-config --cflags --libs opencv4)
+
+#include <iostream>
+#include <cstdlib>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "../kernels.hpp"
+
+#define KCHECK_MAX_COLS 37
+#define KCHECK_PAD 5			// extra bytes per row, source and output
+#define KCHECK_SEED 0x5eed
+
+using namespace std;
+
+/**
+* Check one case
+*
+* @param _factor (int): 2 or 4
+* @param _cn (int): channels
+* @param _cols (int): output width
+* @param _rows (int): output height
+* @param _binary (bool): black and white source instead of uniform noise
+* @param _rng (cv::RNG): random source
+* @return (bool) true if the kernel and cv::resize agree
+*/
+bool checkCase(const int& _factor, const int& _cn, const int& _cols, const int& _rows, const bool& _binary, cv::RNG& _rng)
+{
+	// views on wider matrices: row steps are not packed
+	cv::Mat src_full(_rows * _factor, _cols * _factor + KCHECK_PAD, CV_8UC(_cn));
+	cv::Mat dst_full(_rows, _cols + KCHECK_PAD, CV_8UC(_cn), cv::Scalar::all(0));
+	cv::Mat src = src_full(cv::Rect(0, 0, _cols * _factor, _rows * _factor));
+	cv::Mat dst = dst_full(cv::Rect(0, 0, _cols, _rows));
+	cv::Mat ref;
+
+	_rng.fill(src_full, cv::RNG::UNIFORM, 0, 256);
+	if (_binary)
+		cv::threshold(src_full, src_full, 127, 255, cv::THRESH_BINARY);
+
+	Kernels::boxDownRows(src.data, src.step, dst.data, dst.step, _cols, _cn, _factor, 0, _rows);
+	cv::resize(src, ref, dst.size(), 0, 0, cv::INTER_AREA);
+
+	double max_diff = cv::norm(dst, ref, cv::NORM_INF);
+
+	if (max_diff > 0)
+		cout << "ERR::" << _factor << "x, " << _cn << " channels, " << _cols << "x" << _rows << (_binary ? " binary" : "")
+			 << ": max difference " << max_diff << endl;
+
+	return max_diff == 0;
+}
+
+int main()
+{
+	cv::RNG rng(KCHECK_SEED);
+	int cases = 0, failed = 0;
+
+	for (int factor : { 2, 4 })
+		for (int cn : { 1, 3, 4 })
+			for (int cols = 1; cols <= KCHECK_MAX_COLS; cols++)
+				for (int rows : { 1, 3 })
+					for (bool binary : { false, true })
+					{
+						cases += 1;
+						failed += checkCase(factor, cn, cols, rows, binary, rng) ? 0 : 1;
+					}
+
+	cout << "kernelcheck (" << Kernels::simdName() << "): " << cases - failed << "/" << cases << " cases match cv::resize(INTER_AREA)" << endl;
+
+	return failed == 0 ? 0 : 1;
+}
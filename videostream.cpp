@@ -1,29 +1,44 @@
 #include "videostream.hpp"
 
-Videostream::Videostream(const Tpath& _tpath)
+Videostream::Videostream(const Tpath& _tpath) : frames_batch(1)
 {
 	this->source = _tpath;
 
-	// init frame buffer
-	for (int i = 0; i < BATCH_SIZE; i++)
-		this->frames_batch.push_back(Frame());
-
 	// video info: use non-GPU library because cuda does not hold all these informations
-	cv::VideoCapture cap = cv::VideoCapture(this->source.full_filename);
+	cv::VideoCapture cap;
+	Synthsource synth;
+
+	if (Synthsource::isSynthetic(this->source.full_filename))
+		synth.open(this->source.full_filename);
+	else
+		cap.open(this->source.full_filename);
+
+	auto get = [&](const int& _prop) { return synth.isOpened() ? synth.get(_prop) : cap.get(_prop); };
 		
-	this->width = cap.get(cv::CAP_PROP_FRAME_WIDTH);
-	this->height = cap.get(cv::CAP_PROP_FRAME_HEIGHT);
+	this->width = get(cv::CAP_PROP_FRAME_WIDTH);
+	this->height = get(cv::CAP_PROP_FRAME_HEIGHT);
 	this->area = width * height;
-	this->fps = ceil(cap.get(cv::CAP_PROP_FPS));
-	this->tot_fps = cap.get(cv::CAP_PROP_FRAME_COUNT);
-	this->duration = cap.get(cv::CAP_PROP_FRAME_COUNT) / this->fps;
+	this->media_fps = get(cv::CAP_PROP_FPS);
+	this->fps = ceil(this->media_fps);
+	this->tot_fps = get(cv::CAP_PROP_FRAME_COUNT);
+	this->duration = get(cv::CAP_PROP_FRAME_COUNT) / this->fps;
 
 	cap.release();
+	synth.release();
 
-	// init roi as full image and patch to -1
+	// init analysis at native resolution, roi as full image and patch to -1
+	this->analysis_size = cv::Size(static_cast<int>(this->width), static_cast<int>(this->height));
+	this->scale = 1.0;
+	for (const string& name : Metricregistry::getNames())
+		this->levels[name] = 0;
 	this->blur_roi = cv::Rect(0, 0, static_cast<int>(this->width), static_cast<int>(this->height));
 	for (int i = 0; i < 4; i++)
 		this->patch_info[i] = -1;
+
+	this->stop = false;
+	this->start_frame = 0;
+	this->resume_frame = 0;
+	this->timestamps = false;
 }
 
 
@@ -186,12 +201,119 @@ void Videostream::vec2Patch(const vector<int>& _grid, const bool& _debug)
 	}
 }
 
+/**
+* Analysis resolution
+*
+* Frames are analyzed at _height pixels (same aspect ratio) if that is below the video height.
+* The blur ROI, already checked against the video size, is mapped to analysis pixels, so
+* vec2Patch must run afterwards; the area that normalizes histograms is the analysis area.
+*
+* @param _height (int): analysis height, 0 = native
+* @param _debug (bool): display debug info
+*/
+void Videostream::setScale(const int& _height, const bool& _debug)
+{
+	if (_height <= 0 || _height >= static_cast<int>(this->height))
+		return;
+
+	int w = max(1, static_cast<int>(lround(this->width * _height / this->height)));
+
+	this->analysis_size = cv::Size(w, _height);
+	this->scale = _height / this->height;
+	this->area = static_cast<double>(w) * _height;
+	this->blur_roi = Videostream::scaleRect(this->blur_roi, w / this->width, _height / this->height, this->analysis_size);
+
+	if (_debug)
+		cout << "DEBUG::analysis " << w << "x" << _height << " (scale " << this->scale << "), ROI " << this->blur_roi << endl;
+}
+
+/**
+* Pyramid level of each metric
+*
+* Level k of a frame is the analysis image halved k times (Frame::getLevel). Levels that
+* would be smaller than PYRAMID_MIN_SIZE are lowered. The blur ROI is mapped to the blur
+* level, so vec2Patch must run afterwards.
+*
+* @param _levels (map<string, int>): level of each metric, by name; missing ones are 0
+* @param _debug (bool): display debug info
+*/
+void Videostream::setLevels(const map<string, int>& _levels, const bool& _debug)
+{
+	vector<string> names = Metricregistry::getNames();
+
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		map<string, int>::const_iterator it = _levels.find(names[i]);
+		const int wanted = it != _levels.end() ? it->second : 0;
+		int level = wanted;
+
+		while (level > 0 && min(getLevelSize(level).width, getLevelSize(level).height) < PYRAMID_MIN_SIZE)
+			level -= 1;
+
+		if (level != wanted)
+			cout << "WARNING::pyramid level " << wanted << " of " << names[i] << " is too small: using level " << level << endl;
+
+		this->levels[names[i]] = level;
+	}
+
+	const int blur_level = this->levels["blur"];
+	if (blur_level > 0)
+	{
+		double f = 1.0 / static_cast<double>(1 << blur_level);
+		this->blur_roi = Videostream::scaleRect(this->blur_roi, f, f, getLevelSize(blur_level));
+	}
+
+	if (_debug)
+	{
+		cout << "DEBUG::pyramid levels:";
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			int level = this->levels[names[i]];
+			cout << " " << names[i] << " " << level << " (" << getLevelSize(level).width << "x" << getLevelSize(level).height << ")";
+		}
+		cout << ", blur ROI " << this->blur_roi << endl;
+	}
+}
+
+/**
+* Image size at a pyramid level
+*
+* @param _level (int): pyramid level
+* @return (cv::Size) analysis size halved _level times (rounded down, at least 1)
+*/
+cv::Size Videostream::getLevelSize(const int& _level) const
+{
+	return cv::Size(max(1, this->analysis_size.width >> _level), max(1, this->analysis_size.height >> _level));
+}
+
+/**
+* Scale a rectangle
+*
+* Corners are scaled and rounded, then the rectangle is clipped to the image (at least 1x1).
+*
+* @param _rect (cv::Rect): the rectangle
+* @param _sx (double): horizontal factor
+* @param _sy (double): vertical factor
+* @param _bounds (cv::Size): size of the scaled image
+* @return (cv::Rect) the scaled rectangle
+*/
+cv::Rect Videostream::scaleRect(const cv::Rect& _rect, const double& _sx, const double& _sy, const cv::Size& _bounds)
+{
+	int x0 = min(static_cast<int>(lround(_rect.x * _sx)), _bounds.width - 1);
+	int y0 = min(static_cast<int>(lround(_rect.y * _sy)), _bounds.height - 1);
+	int x1 = static_cast<int>(lround((_rect.x + _rect.width) * _sx));
+	int y1 = static_cast<int>(lround((_rect.y + _rect.height) * _sy));
+
+	return cv::Rect(x0, y0, max(1, min(x1, _bounds.width) - x0), max(1, min(y1, _bounds.height) - y0));
+}
+
 /**
 * Processing video
 * 
-* This is the main function of the program: it loads the video capture
-* and process it frame by frame. A sliding window is introuced for
-* further operations on frames batch.
+* This is the main function of the program: it loads the video capture and process it.
+* The whole video goes through one pipeline (processPipeline), or, if "segments" is set and
+* the reader can seek, it is split in segments that are processed in parallel (processSegments).
+* In both cases the CSV files are the same as a serial run.
 * 
 * @param (Targuments) argument parsed from settings
 * @param (bool) activate debug functions
@@ -202,141 +324,1329 @@ void Videostream::vec2Patch(const vector<int>& _grid, const bool& _debug)
 void Videostream::processing(Targuments _args)
 {
 	/* --- INIT --- */
+	prepare(_args);
+
+	// backend: owns video reader, filters and detectors
+	cv::Ptr<Backend> be = Backend::create(_args.backend, _args.debug);
+
+	// cache: metrics already computed are restored and disabled
+	Resultcache cache(_args.cache_dir);
+	bool any_metric = isPending();
+	map<string, string> cache_keys = lookupCache(cache, _args, be->getName());
+
+	if (any_metric && !isPending())
+	{
+		if (_args.debug)
+			cout << "DEBUG::all metrics restored from cache: " << this->source.basename << endl;
+		return;
+	}
+
+	be->open(this->source.full_filename);
+
+	if (this->sampler.isKeyframes() && !be->keyframesOnly())
+		cout << "WARNING::" << be->getName() << " reader cannot decode keyframes only: decoding every frame" << endl;
+
+	this->stop = false;
+	bool segmented = _args.segments > 1;
+
+	if (segmented && !be->seek(0))
+	{
+		cout << "WARNING::" << be->getName() << " reader cannot seek: processing the video as a single segment" << endl;
+		segmented = false;
+	}
+
+	// file:: a single pipeline keeps checkpoints and may resume a previous run
+	Toutfiles out;
+	this->start_frame = 0;
+	this->resume_frame = 0;
+
+	if (!segmented)
+		this->checkpoint.open(Generica::makeMetaDir(_args.video_path));
+
+	if (segmented || !_args.resume || !resumeOutput(_args, out))
+		openOutput(_args, out);
+
+	startProgress(_args);
+	/* --- EOF::INIT --- */
+
+	if (segmented)
+	{
+		be->release();		// every segment opens its own reader
+		processSegments(_args, out);
+	}
+	else
+	{
+		processPipeline(*be, _args, out);
+		be->release();
+	}
+
+	// close when everything is done
+	closeOutput(out);		// file::
+	stopProgress();
+	cv::destroyAllWindows();
+
+	if (!this->stop)
+		Videostream::storeCache(cache, _args, cache_keys);
+
+	savePerf(_args, be->getName());
+
+	if (_args.debug)
+		Counters::print(cout);
+}
+
+/**
+* Settings of the video
+* 
+* ROI and patches are checked against the video size and scaled to the analysis size and
+* blur level, sampling gets the frame rate, and the enabled metrics are created.
+* Keyframe sampling gets the keyframes of the video.
+* 
+* @param _args (Targuments): argument parsed from settings
+*/
+void Videostream::prepare(Targuments& _args)
+{
+	this->perf.setTracing(_args.trace);
+	this->perf.setCounting(_args.counters);
 	vec2CVRect(_args.blur_roi, _args.debug); // create ROI for blur
+	setScale(_args.analysis_height, _args.debug);
+	setLevels(_args.pyramid_levels, _args.debug);
 	vec2Patch(_args.patch_grid, _args.debug);
-	
+	this->sampler.setup(_args, this->media_fps);
+
+	if (this->sampler.isKeyframes())
+	{
+		vector<int> keyframes = Videostream::findKeyframes(this->source.full_filename);
+
+		if (keyframes.empty())
+		{
+			cout << "WARNING::cannot list the keyframes of " << this->source.basename << ": analyzing every frame" << endl;
+			_args.sampling = SAMPLE_ALL;
+			this->sampler.setup(_args, this->media_fps);
+		}
+		else
+		{
+			this->sampler.setKeyframes(keyframes);
+			this->timestamps = true;
+		}
+	}
+
+	createMetrics(_args);
+	saveAnalysis(_args);
+
 	if (_args.debug)
 	{
 		cout << "DEBUG::video info:" << endl
 			 << "w: " << this->width << ", h: " << this->height << ", fps: " << this->fps << ", sec: " << this->duration << endl;
+
+		if (!this->sampler.isAll())
+			cout << "DEBUG::sampling: " << this->sampler.describe().dump() << endl;
 	}
+}
 
-	// window
-	int new_w = Generica::getNewW(this->width, this->height, NEW_H);
-	const string window_name = "GPU";
-	if (_args.show)
+/**
+* Create the enabled metrics
+*
+* Only the metrics enabled in the settings are created, so that the products, filters and
+* detectors of the others are never built. Each one gets its pyramid level, the size of that
+* level, the blur ROI and the patches. Metrics that read past frames need consecutive frames:
+* they are disabled with keyframe sampling. The products built on each frame are the union
+* of their declarations (Framecontext::makePlan).
+*
+* @param _args (Targuments): settings; metrics disabled here are disabled in it as well
+*/
+void Videostream::createMetrics(Targuments& _args)
+{
+	this->metrics.clear();
+
+	for (const string& name : Metricregistry::getNames())
 	{
-		cv::namedWindow(window_name, cv::WINDOW_OPENGL);
-		cv::cuda::setGlDevice();
-		cv::resizeWindow(window_name, new_w, NEW_H);
+		if (!Metricregistry::isEnabled(_args, name))
+			continue;
+
+		cv::Ptr<Metric> metric = Metricregistry::create(name);
+
+		if (this->sampler.isKeyframes() && metric->getHistory() > 0)
+		{
+			cout << "WARNING::" << name << " needs consecutive frames: disabled with keyframe sampling" << endl;
+			_args.metrics[name] = false;
+			continue;
+		}
+
+		Tmetricsetup setup;
+		setup.level = this->levels.at(name);
+		setup.size = getLevelSize(setup.level);
+		setup.roi = this->blur_roi;
+		for (int i = 0; i < 4; i++)
+			setup.patch_info[i] = this->patch_info[i];
+
+		metric->configure(setup);
+		this->metrics.push_back(metric);
 	}
-		
-	// matrix and video
-	cv::cuda::GpuMat gpu_mat_bgra;
-	cv::Ptr<cv::cudacodec::VideoReader> cap = cv::cudacodec::createVideoReader(this->source.full_filename);
-	cv::Ptr<cv::cuda::Filter> lap = cv::cuda::createLaplacianFilter(CV_8U, CV_8U, 3);
-	cv::Ptr<cv::cuda::CornersDetector> corner_det = cv::cuda::createGoodFeaturesToTrackDetector(CV_8U);		// grayscale
-	cv::Ptr<cv::cuda::SparsePyrLKOpticalFlow> pyrLK_sparse = cv::cuda::SparsePyrLKOpticalFlow::create();	// 1000x1(rxc)
-	
-	/* file:: */
-	string csv_blur_path, csv_exposure_path, csv_entropy_path, csv_motion_path;
-	ofstream csv_blur, csv_exposure, csv_entropy, csv_motion;
 
-	if (_args.blur)
+	planProducts();
+
+	if (_args.debug)
 	{
-		csv_blur_path = Generica::makeCSV(csv_blur, _args.video_path, "blur", this->patch_info);
-		csv_blur.open(csv_blur_path, ios_base::app);
+		cout << "DEBUG::metrics:";
+		for (size_t i = 0; i < this->metrics.size(); i++)
+			cout << " " << this->metrics[i]->getName() << (this->metrics[i]->isTemporal() ? " (temporal)" : "");
+		cout << endl;
 	}
+}
+
+/// products built on each frame for the metrics left: all of them, and the temporal ones for seeds
+void Videostream::planProducts()
+{
+	this->products = Framecontext::makePlan(this->metrics, false);
+	this->seed_products = Framecontext::makePlan(this->metrics, true);
+}
+
+/**
+* Write the analysis settings of the outputs
+*
+* <name>_meta/analysis.json: video and analysis size, scale (analysis height / video height)
+* and, for each enabled metric, its pyramid level and the image size at that level, so that
+* results of runs at different resolutions are not compared by mistake. The CSV files stay
+* plain CSV. Also written when every metric is restored from the cache (same keys, same
+* settings).
+*
+* @param _args (Targuments): settings
+*/
+void Videostream::saveAnalysis(const Targuments& _args) const
+{
+	json info = json::object();
+	info["video_size"] = { static_cast<int>(this->width), static_cast<int>(this->height) };
+	info["analysis_size"] = { this->analysis_size.width, this->analysis_size.height };
+	info["scale"] = this->scale;
+	info["metrics"] = json::object();
 
-	if (_args.exposure)
+	for (size_t i = 0; i < this->metrics.size(); i++)
 	{
-		csv_exposure_path = Generica::makeCSV(csv_exposure, _args.video_path, "exposure");
-		csv_exposure.open(csv_exposure_path, ios_base::app);
+		const Tmetricsetup& setup = this->metrics[i]->getSetup();
+		info["metrics"][this->metrics[i]->getName()] = { { "level", setup.level }, { "size", { setup.size.width, setup.size.height } } };
 	}
 
-	if (_args.entropy)
+	try
 	{
-		csv_entropy_path = Generica::makeCSV(csv_entropy, _args.video_path, "entropy");
-		csv_entropy.open(csv_entropy_path, ios_base::app);
+		filesystem::path path = filesystem::u8path(Generica::makeMetaDir(_args.video_path)) / ANALYSIS_FILE;
+		filesystem::path tmp_path = path;
+		tmp_path += ".tmp";
+		{
+			ofstream tmp(tmp_path, ios_base::trunc);
+			tmp << info.dump(1, '\t') << endl;
+		}
+		filesystem::rename(tmp_path, path);
 	}
-
-	if (_args.motion)
+	catch (const exception& msg)
 	{
-		csv_motion_path = Generica::makeCSV(csv_motion, _args.video_path, "motion");
-		csv_motion.open(csv_motion_path, ios_base::app);
+		cout << "WARNING::cannot write " << ANALYSIS_FILE << ": " << msg.what() << endl;
 	}
-	/* EOF::file INIT */
-	/* --- EOF::INIT --- */
+}
 
-	int count = 0;
-	while (count < static_cast<int>(this->tot_fps))
+/**
+* Anything left to compute
+*
+* @return (bool) true if the video has to be decoded (cached metrics are removed by lookupCache)
+*/
+bool Videostream::isPending() const
+{
+	return !this->metrics.empty() || this->timestamps;
+}
+
+/// some metric reads the previous frame: it is decoded also when it is not sampled
+bool Videostream::readsPrevious() const
+{
+	for (size_t i = 0; i < this->metrics.size(); i++)
+		if ((this->metrics[i]->getProducts() & PRODUCT_PREVIOUS) != 0)
+			return true;
+
+	return false;
+}
+
+/// past frames to keep: as many as the most demanding metric reads
+int Videostream::getHistoryDepth() const
+{
+	int depth = 0;
+	for (size_t i = 0; i < this->metrics.size(); i++)
+		depth = max(depth, this->metrics[i]->getHistory());
+
+	return depth;
+}
+
+/**
+* Whole video as a pipeline
+* 
+* - a decoder thread fills frames taken from a pool (decodeLoop)
+* - a pool of workers computes the per-frame metrics (analyzeLoop)
+* - the calling thread puts the frames back in order, computes the temporal metrics
+*   on the history (motion), writes the CSV files and shows the video (writer)
+* Stages are joined by bounded lock-free queues; the pool bounds the frames in flight.
+* A sliding window (ring buffer) keeps the history needed by the temporal metrics.
+* 
+* @param _be (Backend): compute backend, with the video open
+* @param _args (Targuments): argument parsed from settings
+* @param _out (Toutfiles): open output files
+*/
+void Videostream::processPipeline(Backend& _be, const Targuments& _args, Toutfiles& _out)
+{
+	// history: current frame + the past frames needed by the enabled metrics
+	this->frames_batch = Ringbuffer<Frame>(getHistoryDepth() + 1);
+
+	// window
+	int new_w = Generica::getNewW(this->width, this->height, NEW_H);
+	const string window_name = _be.getName();
+	if (_args.show)
+		_be.openWindow(window_name, new_w, NEW_H);
+
+	// pipeline: frame pool and queues
+	const int workers = Videostream::getWorkers(_args, _be);
+	const int pool_size = workers * (QUEUE_PER_WORKER + 1) + 1;
+	vector<Frame> frame_pool(pool_size);
+	Boundedqueue<Frame*> free_q(pool_size);
+	Boundedqueue<Tinflight> decoded_q(workers * QUEUE_PER_WORKER);
+	Boundedqueue<Tinflight> analyzed_q(pool_size);
+
+	for (int i = 0; i < pool_size; i++)
+		free_q.push(&frame_pool[i]);
+
+	this->progress.watch("decoded", [&decoded_q] { return decoded_q.size(); }, decoded_q.capacity());
+	this->progress.watch("analyzed", [&analyzed_q] { return analyzed_q.size(); }, analyzed_q.capacity());
+
+	if (_args.debug)
+		cout << "DEBUG::pipeline: " << workers << " analysis workers, " << pool_size << " frames in flight" << endl;
+
+	atomic<int> active(workers);
+	thread decoder(&Videostream::decodeLoop, this, ref(_be), ref(free_q), ref(decoded_q));
+	vector<thread> analyzers;
+	for (int i = 0; i < workers; i++)
+		analyzers.push_back(thread(&Videostream::analyzeLoop, this, ref(_be), ref(decoded_q), ref(analyzed_q), ref(active)));
+
+	// writer: frames complete out of order, the reorder window is as large as the pool
+	vector<Frame*> reorder(pool_size, nullptr);
+	long next_seq = 0;
+	Tinflight job;
+	const json fingerprint = getFingerprint(_args);
+	int next_frame = this->resume_frame;		// first frame not written
+	Perf::setCurrent(&this->perf, "writer");
+
+	while (analyzed_q.pop(job))
 	{
-		try
+		reorder[job.seq % pool_size] = job.frame;
+
+		while (reorder[next_seq % pool_size] != nullptr)
 		{
-			if (!cap->nextFrame(gpu_mat_bgra))
+			Frame* decoded = reorder[next_seq % pool_size];
+			reorder[next_seq % pool_size] = nullptr;
+			next_seq += 1;
+
+			if (this->stop)
 			{
-				cout << "DEBUG::No frame!" << count << endl;
-				count += 1;
+				free_q.push(decoded);
 				continue;
 			}
-		}
-		catch (const exception& msg)
-		{
-			cerr << "ERR::" << msg.what() << endl;
-			exit(-1);
-		}
 
-		// possible pre-processing
-		//cv::cuda::resize(gpu_mat_bgra, gpu_mat_bgra, cv::Size(new_w, NEW_H));
-		
-		// sliding window
-		Frame latest_frame = Frame(gpu_mat_bgra, count);
-		Generica::bufferize(this->frames_batch, latest_frame);
-		
-		/* --- ALL FUNCTIONS APPLIED TO THE SINGLE FRAME MUST GO HERE --- */
-		if (_args.blur)
-		{
-			latest_frame.computeBlur(lap, this->blur_roi, this->patch_info);
+			// move the products into the history; the pooled frame gets the old buffers back
+			Frame& latest_frame = this->frames_batch.push();
+			latest_frame.swapProducts(*decoded);
+			int count = latest_frame.getFrameCounter();
 
-			// file::
-			vector<pair<float, float>> bv = latest_frame.getBlurLevel();
-			vector<pair<float, float>>::iterator bvii;
+			// resume and sampling: seed frames only fill the history
+			if (count < this->resume_frame || !this->sampler.keep(count))
+			{
+				free_q.push(decoded);
+				continue;
+			}
 
-			csv_blur << count;
-			for (bvii = bv.begin(); bvii != bv.end(); bvii++)
-				csv_blur << "," << bvii->first << "," << bvii->second;
-			csv_blur << endl;
-		}
+			/* --- ALL FUNCTIONS APPLIED TO THE SINGLE FRAME MUST GO HERE (per-frame ones: analyzeFrame) --- */
+			analyzeHistory(_be, this->frames_batch);
 
-		if (_args.exposure)
-		{
-			latest_frame.computeExposure(V_CHANNEL, MIN_BIN_NUMBER, this->area);
-			csv_exposure << count << "," << latest_frame.getExposureLevel() << endl;	// file::
-		}
+			writeFrame(latest_frame, _out);
+			/* --- EOF --- */
 
-		if (_args.entropy)
-		{
-			latest_frame.computeEntropy(V_CHANNEL, MAX_BIN_NUMBER, this->area);
-			csv_entropy << count << "," << latest_frame.getEntropyLevel() << endl;	// file::
+			Counters::frames.fetch_add(1, memory_order_relaxed);
+			this->perf.addFrame();
+			next_frame = count + 1;
+			if (this->checkpoint.due())
+				this->checkpoint.save(fingerprint, next_frame, Videostream::getOutputSizes(_out), false);
+
+			// show window if specified
+			if (_args.show)
+			{
+				Stagetimer timer(STAGE_SHOW, count);
+				_be.show(window_name, *decoded);
+
+				// Press ESC on keyboard to exit
+				char c = (char)cv::waitKey(1);
+				if (c == 27)
+					this->stop = true;
+			}
+
+			free_q.push(decoded);
 		}
+	}
+
+	decoder.join();
+	for (size_t i = 0; i < analyzers.size(); i++)
+		analyzers[i].join();
+	Perf::setCurrent(nullptr);
+	this->progress.unwatch();
+
+	// stopped by the user: resumable; otherwise the next run starts over
+	this->checkpoint.save(fingerprint, next_frame, Videostream::getOutputSizes(_out), !this->stop);
+
+	if (_args.debug)
+	{
+		size_t history_bytes = 0, pool_bytes = 0;
+		for (size_t i = 0; i < this->frames_batch.capacity(); i++)
+			history_bytes += this->frames_batch.prev(i).getBytes();
+		for (int i = 0; i < pool_size; i++)
+			pool_bytes += frame_pool[i].getBytes();
+
+		cout << "DEBUG::history: " << this->frames_batch.capacity() << " slots, " << history_bytes / (1024 * 1024) << " MB" << endl
+			 << "DEBUG::frame pool: " << pool_size << " frames, " << pool_bytes / (1024 * 1024) << " MB" << endl;
+	}
+}
+
+/**
+* Whole video as parallel segments
+* 
+* The video is split in keyframe-aligned segments (findSegments), each one decoded and
+* analyzed serially by its own thread with its own reader, backend and history, and
+* written to its own part files. The parts are appended to the CSV files in order.
+* 
+* @param _args (Targuments): argument parsed from settings
+* @param _out (Toutfiles): open output files
+*/
+void Videostream::processSegments(const Targuments& _args, Toutfiles& _out)
+{
+	vector<Tsegment> segments = getSegments(_args.segments);
+
+	if (_args.show)
+		cout << "WARNING::segments are processed out of order: show is disabled" << endl;
+
+	if (_args.debug)
+	{
+		cout << "DEBUG::segments: " << segments.size() << endl;
+		for (size_t i = 0; i < segments.size(); i++)
+			cout << "DEBUG::segment " << i << ": frames [" << segments[i].begin << ", " << segments[i].end << ")" << endl;
+	}
+
+	vector<Toutfiles> parts(segments.size());
+	vector<thread> segment_threads;
+
+	for (size_t i = 0; i < segments.size(); i++)
+	{
+		openParts(_out, parts[i], static_cast<int>(i));
+		segment_threads.push_back(thread(&Videostream::segmentLoop, this, cref(_args), cref(segments[i]), ref(parts[i])));
+	}
+
+	for (size_t i = 0; i < segments.size(); i++)
+		segment_threads[i].join();
+
+	Videostream::stitch(_out, parts);
+}
+
+/**
+* Segments of the video
+* 
+* @param _n (int): requested number of segments
+* @return (vector<Tsegment>) see findSegments
+*/
+vector<Tsegment> Videostream::getSegments(const int& _n) const
+{
+	return Videostream::findSegments(this->source.full_filename, static_cast<int>(this->tot_fps), _n);
+}
+
+int Videostream::getFrameCount() const
+{
+	return static_cast<int>(this->tot_fps);
+}
+
+/**
+* Append the part files of the segments to the output files
+* 
+* Segments are contiguous, so appending the parts in order gives the serial output.
+* 
+* @param _out (Toutfiles): open output files
+* @param _parts (vector<Toutfiles>): part files of the segments, in order; closed and deleted
+*/
+void Videostream::stitch(Toutfiles& _out, vector<Toutfiles>& _parts)
+{
+	for (size_t i = 0; i < _parts.size(); i++)
+	{
+		Videostream::closeOutput(_parts[i]);
+
+		for (Toutfiles::iterator it = _parts[i].begin(); it != _parts[i].end(); it++)
+			Videostream::appendPart(_out[it->first], it->second);
+	}
+}
+
+/**
+* Segment worker
+* 
+* Serial decode-analyze-write loop on [begin, end). Motion needs the frame before the first
+* one: if the segment does not start the video, that frame is decoded too (preroll), only to
+* fill the history. Frames out of the sample are skipped, as in the pipeline.
+* 
+* @param _args (Targuments): argument parsed from settings
+* @param _seg (Tsegment): frames of the segment
+* @param _out (Toutfiles): part files of the segment
+* @return (long) number of frames analyzed
+*/
+long Videostream::segmentLoop(const Targuments& _args, const Tsegment& _seg, Toutfiles& _out)
+{
+	long analyzed = 0;
+	Perf::setCurrent(&this->perf, "segment");
+
+	try
+	{
+		cv::Ptr<Backend> be = Backend::create(_args.backend, false);
+		be->open(this->source.full_filename);
+		if (this->sampler.isKeyframes())
+			be->keyframesOnly();
+
+		Ringbuffer<Frame> history(getHistoryDepth() + 1);
+		const bool previous = readsPrevious();
+		int count = (previous && _seg.begin > 0) ? _seg.begin - 1 : _seg.begin;
 
-		if (_args.motion)
+		if (count > 0 && !be->seek(count))
 		{
-			latest_frame.computeMotion(this->frames_batch, corner_det, pyrLK_sparse);
-			csv_motion << count << "," << latest_frame.getMotionLevel() << endl;	// file::
+			cerr << "ERR::cannot seek to frame " << count << ". Quitting..." << endl;
+			exit(-1);
 		}
-		/* --- EOF --- */
 
-		// show window if specified
-		if (_args.show)
+		for (; count < _seg.end && !this->stop; count++)
 		{
-			cv::imshow(window_name, gpu_mat_bgra);
+			int state = this->sampler.classify(count, previous);
+			if (count < _seg.begin && state == FRAME_KEEP)
+				state = FRAME_SEED;		// preroll
 
-			// Press ESC on keyboard to exit
-			char c = (char)cv::waitKey(1);
-			if (c == 27)
-				break;
-		}
+			if (state == FRAME_SKIP)
+			{
+				Stagetimer timer(STAGE_DECODE, count);
+				be->skipFrame();
+				continue;
+			}
 
-		count += 1;
-	}
+			Frame& slot = history.next();
+			const uchar* old_data = slot.getImageData();
+			slot.reset(count);
 
-	// close when everything is done
-	csv_blur.close();		// file::
-	csv_exposure.close();	
-	csv_entropy.close();
-	csv_motion.close();
-	
-	cap.release();			// or cap->~VideoReader();
-	cv::destroyAllWindows();
+			bool decoded;
+			{
+				Stagetimer timer(STAGE_DECODE, count);
+				decoded = be->nextFrame(slot);
+			}
+
+			if (!decoded)
+			{
+				cout << "DEBUG::No frame!" << count << endl;
+				continue;
+			}
+
+			if (slot.getImageData() != old_data)
+				Counters::buffer_allocs.fetch_add(1, memory_order_relaxed);
+
+			Frame& latest_frame = history.push();
+			latest_frame.downscale(*be, this->analysis_size);
+
+			// preroll and sampling seeds: only what the temporal metrics of the next frame need
+			if (state == FRAME_SEED)
+			{
+				seedFrame(*be, latest_frame);
+				continue;
+			}
+
+			analyzeFrame(*be, latest_frame);
+			analyzeHistory(*be, history);
+
+			writeFrame(latest_frame, _out);
+			Counters::frames.fetch_add(1, memory_order_relaxed);
+			this->perf.addFrame();
+			analyzed += 1;
+		}
+
+		be->release();
+	}
+	catch (const exception& msg)
+	{
+		cerr << "ERR::" << msg.what() << endl;
+		exit(-1);
+	}
+
+	Perf::setCurrent(nullptr);
+	return analyzed;
+}
+
+/**
+* Split the video in segments
+* 
+* Boundaries are evenly spaced, then moved back to the closest keyframe, so that each reader
+* starts decoding where the stream can be decoded from. Keyframes are found by reading the
+* packets without decoding them; if the reader cannot do that, boundaries stay evenly spaced
+* (the seek decodes from the previous keyframe anyway, it is only slower).
+* 
+* @param _filename (string): full path to the video
+* @param _tot_frames (int): number of frames
+* @param _n (int): requested number of segments
+* @return (vector<Tsegment>) contiguous, non-empty segments covering [0, _tot_frames)
+*/
+vector<Tsegment> Videostream::findSegments(const string& _filename, const int& _tot_frames, const int& _n)
+{
+	vector<int> keyframes = Videostream::findKeyframes(_filename);
+	vector<int> bounds = { 0 };
+
+	for (int i = 1; i < _n; i++)
+	{
+		int b = static_cast<int>(static_cast<long>(_tot_frames) * i / _n);
+
+		// closest keyframe before b
+		vector<int>::iterator kf = upper_bound(keyframes.begin(), keyframes.end(), b);
+		if (kf != keyframes.begin())
+			b = *(kf - 1);
+
+		if (b > bounds.back())
+			bounds.push_back(b);
+	}
+
+	bounds.push_back(_tot_frames);
+
+	vector<Tsegment> segments;
+	for (size_t i = 0; i + 1 < bounds.size(); i++)
+		if (bounds[i + 1] > bounds[i])
+			segments.push_back({ bounds[i], bounds[i + 1] });
+
+	return segments;
+}
+
+/**
+* Keyframe indices
+* 
+* Read from the packets of the video, without decoding them (Keyframereader::listKeyframes),
+* in presentation order. Synthetic videos have one keyframe every "gop" frames.
+* 
+* @param _filename (string): full path to the video
+* @return (vector<int>) sorted frame indices of the keyframes, empty if not available (no libav)
+*/
+vector<int> Videostream::findKeyframes(const string& _filename)
+{
+	vector<int> keyframes;
+
+	if (Synthsource::isSynthetic(_filename))
+	{
+		Synthsource synth;
+		if (synth.open(_filename))
+			keyframes = synth.getKeyframes();
+
+		return keyframes;
+	}
+
+#if USE_LIBAV
+	keyframes = Keyframereader::listKeyframes(_filename);
+#endif
+
+	return keyframes;
+}
+
+/**
+* Write the results of a frame
+* 
+* @param _frame (Frame): analyzed frame, with the row of each enabled metric
+* @param _out (Toutfiles): open output files
+*/
+void Videostream::writeFrame(Frame& _frame, Toutfiles& _out)
+{
+	int count = _frame.getFrameCounter();
+	Stagetimer timer(STAGE_WRITE, count);
+
+	for (size_t i = 0; i < this->metrics.size(); i++)
+	{
+		const vector<float>& row = _frame.getRow(static_cast<int>(i));
+		Videostream::writeRow(_out[this->metrics[i]->getName()], count, row.data(), static_cast<int>(row.size()));
+	}
+
+	// whole milliseconds: exact in float32 up to 4.6 hours; estimated from the frame rate if the reader does not tell
+	if (this->timestamps)
+	{
+		double pts = _frame.getTimestamp();
+		if (pts < 0.0 && this->media_fps > 0.0)
+			pts = count * 1000.0 / this->media_fps;
+		int pts_ms = static_cast<int>(lround(pts));
+		Tmetricfiles& keyframes = _out[KEYFRAMES_OUTPUT];
+
+		if (keyframes.csv.isOpen())
+		{
+			keyframes.csv << count << ',' << pts_ms;
+			keyframes.csv.endLine();
+		}
+
+		float value = static_cast<float>(pts_ms);
+		if (keyframes.cols.isOpen())
+			keyframes.cols.putRow(count, &value, 1);
+	}
+}
+
+/**
+* Write a row of a metric in the enabled formats
+* 
+* @param _files (Tmetricfiles): output files of the metric
+* @param _count (int): frame number
+* @param _values (float*): values of the row
+* @param _n (int): number of values
+*/
+void Videostream::writeRow(Tmetricfiles& _files, const int& _count, const float _values[], const int& _n)
+{
+	if (_files.csv.isOpen())
+	{
+		_files.csv << _count;
+		for (int i = 0; i < _n; i++)
+			_files.csv << ',' << _values[i];
+		_files.csv.endLine();
+	}
+
+	if (_files.cols.isOpen())
+		_files.cols.putRow(_count, _values, _n);
+}
+
+/**
+* Create the output files of the enabled metrics and open them
+* 
+* Columns and patches are declared by each metric (Metric::getColumns, getPatchInfo).
+* 
+* @param _args (Targuments): settings
+* @param _out (Toutfiles): output files
+*/
+void Videostream::openOutput(Targuments& _args, Toutfiles& _out)
+{
+	for (size_t i = 0; i < this->metrics.size(); i++)
+	{
+		const Metric& metric = *this->metrics[i];
+		Videostream::openMetric(_args, metric.getName(), _out[metric.getName()], metric.getColumns(), metric.getPatchInfo(), this->scale, metric.getSetup().level);
+	}
+
+	if (this->timestamps)
+		Videostream::openMetric(_args, KEYFRAMES_OUTPUT, _out[KEYFRAMES_OUTPUT], vector<string>{ "pts_ms" }, nullptr, 1.0, 0);
+}
+
+/**
+* Create the output files of a metric, in the formats of "output_format"
+* 
+* - csv: <name>_meta/<feature>.csv, with header (scale and level are in analysis.json)
+* - columns: <name>_meta/<feature>.cols/, see Colwriter
+* 
+* @param _args (Targuments): settings
+* @param _feature_name (string): the metric
+* @param _files (Tmetricfiles): output files of the metric
+* @param _columns (vector<string>): value columns, frame_n excluded
+* @param _patch_info (int*): nx, ny, w, h; nullptr if the metric has no patches
+* @param _scale (double): analysis scale, recorded in the column header
+* @param _level (int): pyramid level of the metric, recorded in the column header
+*/
+void Videostream::openMetric(Targuments& _args, const string& _feature_name, Tmetricfiles& _files, const vector<string>& _columns, const int _patch_info[], const double& _scale, const int& _level)
+{
+	if (_args.output_format.compare(OUTPUT_COLUMNS) != 0)
+	{
+		ofstream header;
+		_files.csv_path = Generica::makeCSV(header, _args.video_path, _feature_name, _columns);
+		_files.csv.open(_files.csv_path, true);
+	}
+
+	if (_args.output_format.compare(OUTPUT_CSV) != 0)
+	{
+		filesystem::path meta_dir = filesystem::u8path(Generica::makeMetaDir(_args.video_path));
+		_files.cols_path = (meta_dir / filesystem::u8path(_feature_name) += ".cols").string();
+		_files.cols.open(_files.cols_path, _feature_name, _columns, _patch_info, _scale, _level);
+	}
+}
+
+/**
+* Open the part files of a segment, next to the output files
+* 
+* @param _out (Toutfiles): output files
+* @param _part (Toutfiles): part files, one for each open output file
+* @param _index (int): segment index
+*/
+void Videostream::openParts(const Toutfiles& _out, Toutfiles& _part, const int& _index)
+{
+	const string suffix = ".part" + to_string(_index);
+
+	for (Toutfiles::const_iterator it = _out.begin(); it != _out.end(); it++)
+		Videostream::openPart(it->second, _part[it->first], suffix);
+}
+
+/**
+* Open the part files of a metric (nothing if the metric is disabled)
+* 
+* @param _files (Tmetricfiles): output files of the metric
+* @param _part (Tmetricfiles): part files of the metric
+* @param _suffix (string): appended to the output paths
+*/
+void Videostream::openPart(const Tmetricfiles& _files, Tmetricfiles& _part, const string& _suffix)
+{
+	if (!_files.csv_path.empty())
+	{
+		_part.csv_path = _files.csv_path + _suffix;
+		_part.csv.open(_part.csv_path, false);
+	}
+
+	if (!_files.cols_path.empty())
+	{
+		_part.cols_path = _files.cols_path + _suffix;
+		_part.cols.openLike(_part.cols_path, _files.cols);
+	}
+}
+
+void Videostream::closeOutput(Toutfiles& _out)
+{
+	for (Toutfiles::iterator it = _out.begin(); it != _out.end(); it++)
+	{
+		it->second.csv.close();
+		it->second.cols.close();
+	}
+}
+
+/**
+* Append the part files of a metric to its output files and delete them
+* 
+* @param _dst (Tmetricfiles): open output files
+* @param _part (Tmetricfiles): closed part files, nothing to do for empty paths
+*/
+void Videostream::appendPart(Tmetricfiles& _dst, const Tmetricfiles& _part)
+{
+	if (!_part.csv_path.empty())
+	{
+		_dst.csv.appendFile(_part.csv_path);
+		filesystem::remove(filesystem::u8path(_part.csv_path));
+	}
+
+	if (!_part.cols_path.empty())
+	{
+		_dst.cols.appendDir(_part.cols_path);
+		filesystem::remove_all(filesystem::u8path(_part.cols_path));
+	}
+}
+
+/**
+* Resume the outputs of an interrupted run
+* 
+* If the checkpoint of the video matches this run, the output files are truncated to their size
+* at the checkpoint and reopened for append, and decoding restarts one frame earlier than the
+* first frame to write, to rebuild the motion seed.
+* 
+* @param _args (Targuments): argument parsed from settings
+* @param _out (Toutfiles): output files, opened if resuming
+* @return (bool) false if there is nothing to resume (the outputs are not touched)
+*/
+bool Videostream::resumeOutput(Targuments& _args, Toutfiles& _out)
+{
+	if (!this->checkpoint.load(getFingerprint(_args)))
+		return false;
+
+	const string meta_dir = Generica::makeMetaDir(_args.video_path);
+	const json sizes = this->checkpoint.getOutputs();
+	bool ok = true;
+
+	for (size_t i = 0; i < this->metrics.size(); i++)
+	{
+		const string name = this->metrics[i]->getName();
+		ok = ok && Videostream::resumeMetric(_out[name], meta_dir, name, sizes);
+	}
+	if (this->timestamps)
+		ok = ok && Videostream::resumeMetric(_out[KEYFRAMES_OUTPUT], meta_dir, KEYFRAMES_OUTPUT, sizes);
+
+	if (!ok)
+	{
+		cout << "WARNING::outputs do not match the checkpoint: starting over" << endl;
+		closeOutput(_out);
+		_out.clear();
+		return false;
+	}
+
+	this->resume_frame = this->checkpoint.getNextFrame();
+	this->start_frame = readsPrevious() ? max(0, this->checkpoint.getSeedFrame()) : this->resume_frame;
+
+	if (_args.debug)
+		cout << "DEBUG::resuming from frame " << this->resume_frame << " (decoding from " << this->start_frame << ")" << endl;
+
+	return true;
+}
+
+/**
+* Reopen the output files of a metric at their checkpoint size
+* 
+* @param _files (Tmetricfiles): output files of the metric
+* @param _meta_dir (string): the <name>_meta directory
+* @param _feature_name (string): the metric
+* @param _sizes (json): output sizes at the checkpoint, see getOutputSizes
+* @return (bool) false if a file is missing or shorter than at the checkpoint
+*/
+bool Videostream::resumeMetric(Tmetricfiles& _files, const string& _meta_dir, const string& _feature_name, const json& _sizes)
+{
+	if (!_sizes.contains(_feature_name))
+		return false;
+
+	const json& sizes = _sizes.at(_feature_name);
+
+	if (sizes.contains("csv"))
+	{
+		filesystem::path csv_path = filesystem::u8path(_meta_dir) / filesystem::u8path(_feature_name) += ".csv";
+		uintmax_t bytes = sizes.at("csv").get<uintmax_t>();
+
+		if (!filesystem::exists(csv_path) || filesystem::file_size(csv_path) < bytes)
+			return false;
+
+		filesystem::resize_file(csv_path, bytes);
+		_files.csv_path = csv_path.string();
+		_files.csv.open(_files.csv_path, true);
+	}
+
+	if (sizes.contains("cols"))
+	{
+		filesystem::path cols_path = filesystem::u8path(_meta_dir) / filesystem::u8path(_feature_name) += ".cols";
+
+		if (!_files.cols.resume(cols_path.string(), sizes.at("cols").get<size_t>()))
+			return false;
+
+		_files.cols_path = cols_path.string();
+	}
+
+	return true;
+}
+
+/**
+* Flush the output files and get their size
+* 
+* @param _out (Toutfiles): open output files
+* @return (json) { feature: { "csv": bytes, "cols": rows } } for the open files
+*/
+json Videostream::getOutputSizes(Toutfiles& _out)
+{
+	json sizes = json::object();
+
+	for (Toutfiles::iterator it = _out.begin(); it != _out.end(); it++)
+	{
+		Tmetricfiles& files = it->second;
+
+		if (files.csv.isOpen())
+		{
+			files.csv.flush();
+			sizes[it->first]["csv"] = filesystem::file_size(filesystem::u8path(files.csv_path));
+		}
+
+		if (files.cols.isOpen())
+		{
+			files.cols.flush();
+			sizes[it->first]["cols"] = files.cols.getRows();
+		}
+	}
+
+	return sizes;
+}
+
+/**
+* What the outputs depend on: video and settings
+* 
+* @param _args (Targuments): argument parsed from settings
+* @return (json) fingerprint, compared by the checkpoint
+*/
+json Videostream::getFingerprint(const Targuments& _args) const
+{
+	json fp = json::object();
+
+	fp["video"] = this->source.full_filename;
+	fp["video_bytes"] = filesystem::file_size(filesystem::u8path(this->source.full_filename));
+	fp["frames"] = static_cast<int>(this->tot_fps);
+	fp["metrics"] = json::array();
+	for (const string& name : Metricregistry::getNames())
+		fp["metrics"].push_back(Metricregistry::isEnabled(_args, name));
+	fp["blur_roi"] = { this->blur_roi.x, this->blur_roi.y, this->blur_roi.width, this->blur_roi.height };
+	fp["patch_info"] = { this->patch_info[0], this->patch_info[1], this->patch_info[2], this->patch_info[3] };
+	fp["output_format"] = _args.output_format;
+	if (!this->sampler.isAll())
+		fp["sampling"] = this->sampler.describe();
+	if (this->scale != 1.0)
+		fp["analysis_size"] = { this->analysis_size.width, this->analysis_size.height };
+
+	json levels = json::array();
+	bool pyramid = false;
+	for (const string& name : Metricregistry::getNames())
+	{
+		levels.push_back(this->levels.at(name));
+		pyramid = pyramid || this->levels.at(name) > 0;
+	}
+	if (pyramid)
+		fp["pyramid_levels"] = levels;
+
+	return fp;
+}
+
+/**
+* Write the performance report of the video
+*
+* <name>_meta/perf.json: per-stage totals and latency percentiles (Perf), frames written,
+* wall time and frames per second. Stage times are self times, summed over all threads, so
+* with parallel workers they can add up to more than the wall time. With "trace", also
+* <name>_meta/trace.json (Perf::saveTrace).
+*
+* @param _args (Targuments): settings
+* @param _backend_name (string): backend that processed the video
+*/
+void Videostream::savePerf(const Targuments& _args, const string& _backend_name) const
+{
+	json info = json::object();
+	info["video"] = this->source.full_filename;
+	info["backend"] = _backend_name;
+	info["frames_total"] = static_cast<int>(this->tot_fps);
+	info["analysis_size"] = { this->analysis_size.width, this->analysis_size.height };
+
+	try
+	{
+		this->perf.save(Generica::makeMetaDir(_args.video_path), info);
+		if (this->perf.isTracing())
+			this->perf.saveTrace(Generica::makeMetaDir(_args.video_path), info);
+	}
+	catch (const exception& msg)
+	{
+		cout << "WARNING::cannot write " << PERF_FILE << " or " << TRACE_FILE << ": " << msg.what() << endl;
+		return;
+	}
+
+	if (_args.debug)
+	{
+		json r = this->perf.report();
+		for (json::iterator it = r["stages"].begin(); it != r["stages"].end(); it++)
+			cout << "DEBUG::perf " << it.key() << ": " << it.value()["ms_per_frame"].get<double>() << " ms/frame (p50 "
+				<< it.value()["p50_us"].get<double>() << " us, p99 " << it.value()["p99_us"].get<double>() << " us)" << endl;
+		for (json::iterator it = r["stages"].begin(); it != r["stages"].end(); it++)
+			if (it.value().contains("counters"))
+				cout << "DEBUG::perf " << it.key() << ": IPC " << it.value()["counters"]["ipc"].get<double>() << ", "
+					<< it.value()["counters"]["llc_misses_per_frame"].get<double>() << " LLC misses/frame" << endl;
+		cout << "DEBUG::perf: " << r["frames"].get<long>() << " frames, " << r["fps"].get<double>() << " fps" << endl;
+	}
+}
+
+/**
+* Start the progress monitor, if "progress" is set
+*
+* Call it once the outputs are open (and a resume point is known).
+*
+* @param _args (Targuments): settings
+*/
+void Videostream::startProgress(Targuments& _args)
+{
+	if (_args.progress <= 0)
+		return;
+
+	this->progress.start(this->source.basename, Generica::makeMetaDir(_args.video_path), _args.progress, getPendingFrames(),
+		[this] { return this->perf.getFrames(); });
+}
+
+/// final status: done, or stopped by the user
+void Videostream::stopProgress()
+{
+	this->progress.stop(this->stop ? STATUS_STOPPED : STATUS_DONE);
+}
+
+/**
+* Frames this run will write
+*
+* @return (long) frames in the sample from the resume point to the end of the video
+*/
+long Videostream::getPendingFrames() const
+{
+	long pending = 0;
+	for (int i = this->resume_frame; i < static_cast<int>(this->tot_fps); i++)
+		if (this->sampler.keep(i))
+			pending += 1;
+
+	return pending;
+}
+
+/**
+* Restore the cached metrics
+* 
+* Every enabled metric whose result is in the cache is placed in the <name>_meta directory and
+* disabled in _args.
+* 
+* @param _cache (Resultcache): the cache
+* @param _args (Targuments): settings; cached metrics are disabled
+* @param _backend_name (string): backend computing the metrics
+* @return (map) key of every metric still to compute, to store its result at the end
+*/
+map<string, string> Videostream::lookupCache(const Resultcache& _cache, Targuments& _args, const string& _backend_name)
+{
+	map<string, string> keys;
+
+	if (!_cache.isEnabled())
+		return keys;
+
+	const string meta_dir = Generica::makeMetaDir(_args.video_path);
+	const uint64_t content_hash = Resultcache::hashContent(this->source.full_filename);
+	vector<string> names;
+	for (size_t i = 0; i < this->metrics.size(); i++)
+		names.push_back(this->metrics[i]->getName());
+	if (this->timestamps)
+		names.push_back(KEYFRAMES_OUTPUT);
+
+	for (const string& name : names)
+	{
+		string key = _cache.getKey(content_hash, name, getMetricParams(name, _backend_name));
+
+		if (!_cache.restore(key, meta_dir, name, _args.output_format))
+		{
+			keys[name] = key;
+			continue;
+		}
+
+		if (name.compare(KEYFRAMES_OUTPUT) == 0)
+		{
+			this->timestamps = false;
+		}
+		else
+		{
+			_args.metrics[name] = false;
+			this->metrics.erase(remove_if(this->metrics.begin(), this->metrics.end(),
+				[&name](const cv::Ptr<Metric>& _metric) { return _metric->getName().compare(name) == 0; }), this->metrics.end());
+			planProducts();
+		}
+
+		if (_args.debug)
+			cout << "DEBUG::cache: " << name << " restored (" << key << ")" << endl;
+	}
+
+	return keys;
+}
+
+/**
+* Store the computed metrics in the cache
+* 
+* @param _cache (Resultcache): the cache
+* @param _args (Targuments): settings
+* @param _keys (map): see lookupCache; the outputs must be closed
+*/
+void Videostream::storeCache(const Resultcache& _cache, Targuments& _args, const map<string, string>& _keys)
+{
+	if (!_cache.isEnabled())
+		return;
+
+	const string meta_dir = Generica::makeMetaDir(_args.video_path);
+
+	for (map<string, string>::const_iterator it = _keys.begin(); it != _keys.end(); it++)
+		_cache.store(it->second, meta_dir, it->first, _args.output_format);
+}
+
+/**
+* Parameters a metric depends on, besides the video
+* 
+* Any setting that changes the results of a metric must be here, or a stale result is reused.
+* 
+* @param _feature_name (string): the metric
+* @param _backend_name (string): backend computing the metric
+* @return (json) the parameters
+*/
+json Videostream::getMetricParams(const string& _feature_name, const string& _backend_name) const
+{
+	json params = json::object();
+	params["backend"] = _backend_name;
+	if (!this->sampler.isAll())
+		params["sampling"] = this->sampler.describe();		// absent when every frame is analyzed: older keys stay valid
+	if (this->scale != 1.0 && _feature_name.compare(KEYFRAMES_OUTPUT) != 0)
+		params["analysis_size"] = { this->analysis_size.width, this->analysis_size.height };
+
+	// the metric adds its own (Metric::getParams)
+	for (size_t i = 0; i < this->metrics.size(); i++)
+	{
+		if (this->metrics[i]->getName().compare(_feature_name) != 0)
+			continue;
+
+		if (this->metrics[i]->getSetup().level > 0)
+			params["level"] = this->metrics[i]->getSetup().level;
+		params.update(this->metrics[i]->getParams());
+	}
+
+	return params;
+}
+
+/**
+* Decoder stage
+*
+* Takes a free frame from the pool, decodes in place into it (its buffers are recycled) and
+* hands it to the workers with its decoding order. Closes the decoded queue at the end of the
+* video or when the writer asks to stop. Frames out of the sample are skipped by the reader,
+* before any copy or colour conversion, and never enter the pipeline.
+*
+* @param _be (Backend): compute backend, owner of the video reader
+* @param _free_q (Boundedqueue): frames available for decoding
+* @param _decoded_q (Boundedqueue): decoded frames, to the workers
+*/
+void Videostream::decodeLoop(Backend& _be, Boundedqueue<Frame*>& _free_q, Boundedqueue<Tinflight>& _decoded_q)
+{
+	Tinflight job;
+	long seq = 0;
+	int count = this->start_frame;
+	Perf::setCurrent(&this->perf, "decoder");
+
+	// resume: the reader restarts from the keyframe before start_frame; without seek, skip
+	if (count > 0 && !_be.seek(count))
+	{
+		for (int i = 0; i < count && !this->stop; i++)
+			_be.skipFrame();
+	}
+
+	while (count < static_cast<int>(this->tot_fps) && !this->stop)
+	{
+		if (this->sampler.classify(count, readsPrevious()) == FRAME_SKIP)
+		{
+			Stagetimer timer(STAGE_DECODE, count);
+			if (!_be.skipFrame())
+				cout << "DEBUG::No frame!" << count << endl;
+
+			count += 1;
+			continue;
+		}
+
+		_free_q.pop(job.frame);
+		const uchar* old_data = job.frame->getImageData();
+		job.frame->reset(count);
+
+		try
+		{
+			Stagetimer timer(STAGE_DECODE, count);
+			if (!_be.nextFrame(*job.frame))
+			{
+				cout << "DEBUG::No frame!" << count << endl;
+				_free_q.push(job.frame);
+				count += 1;
+				continue;
+			}
+		}
+		catch (const exception& msg)
+		{
+			cerr << "ERR::" << msg.what() << endl;
+			exit(-1);
+		}
+
+		if (job.frame->getImageData() != old_data)
+			Counters::buffer_allocs.fetch_add(1, memory_order_relaxed);
+
+		job.seq = seq;
+		_decoded_q.push(job);
+		seq += 1;
+		count += 1;
+	}
+
+	_decoded_q.close();
+	Perf::setCurrent(nullptr);
+}
+
+/**
+* Analysis worker
+*
+* Computes the per-frame metrics of the decoded frames, in any order; seed frames (decoded
+* only for the temporal metrics of the next sampled frame) get what those need. The last
+* worker to finish closes the analyzed queue.
+*
+* @param _be (Backend): compute backend
+* @param _decoded_q (Boundedqueue): decoded frames, from the decoder
+* @param _analyzed_q (Boundedqueue): analyzed frames, to the writer
+* @param _active (atomic<int>): workers still running
+*/
+void Videostream::analyzeLoop(Backend& _be, Boundedqueue<Tinflight>& _decoded_q, Boundedqueue<Tinflight>& _analyzed_q, atomic<int>& _active)
+{
+	Tinflight job;
+	Perf::setCurrent(&this->perf, "worker");
+
+	while (_decoded_q.pop(job))
+	{
+		try
+		{
+			job.frame->downscale(_be, this->analysis_size);
+
+			if (this->sampler.keep(job.frame->getFrameCounter()))
+				analyzeFrame(_be, *job.frame);
+			else
+				seedFrame(_be, *job.frame);
+		}
+		catch (const exception& msg)
+		{
+			cerr << "ERR::" << msg.what() << endl;
+			exit(-1);
+		}
+
+		_analyzed_q.push(job);
+	}
+
+	Perf::setCurrent(nullptr);
+	if (--_active == 0)
+		_analyzed_q.close();
+}
+
+/**
+* Per-frame metrics
+*
+* Builds the products of every enabled metric, then computes everything that depends on the
+* frame alone. Temporal metrics read the previous frame and run in order, in the writer
+* (analyzeHistory), on the products built here (e.g. gray plane and features for motion).
+*
+* @param _be (Backend): compute backend
+* @param _frame (Frame): decoded frame
+*/
+void Videostream::analyzeFrame(Backend& _be, Frame& _frame)
+{
+	Framecontext ctx(_be, _frame, this->products);
+	ctx.build();
+
+	for (size_t i = 0; i < this->metrics.size(); i++)
+		if (!this->metrics[i]->isTemporal())
+			this->metrics[i]->compute(ctx, _frame.getRow(static_cast<int>(i)));
+}
+
+/**
+* Seed frame: not written, only the previous frame of the next one
+*
+* Only the products of the temporal metrics are built.
+*
+* @param _be (Backend): compute backend
+* @param _frame (Frame): decoded frame
+*/
+void Videostream::seedFrame(Backend& _be, Frame& _frame)
+{
+	Framecontext ctx(_be, _frame, this->seed_products);
+	ctx.build();
+}
+
+/**
+* Temporal metrics of the last frame of the history
+*
+* @param _be (Backend): compute backend
+* @param _history (Ringbuffer<Frame>): history, the frame to analyze is the last one
+*/
+void Videostream::analyzeHistory(Backend& _be, Ringbuffer<Frame>& _history)
+{
+	Frame& frame = _history.back();
+	Framecontext ctx(_be, frame, this->products, &_history);
+
+	for (size_t i = 0; i < this->metrics.size(); i++)
+		if (this->metrics[i]->isTemporal())
+			this->metrics[i]->compute(ctx, frame.getRow(static_cast<int>(i)));
+}
+
+/**
+* Number of analysis workers
+*
+* "workers" in settings, or all the cores but the decoder's if 0; never more than the
+* backend supports.
+*
+* @param _args (Targuments): parsed settings
+* @param _be (Backend): compute backend
+* @return (int) number of analysis workers, >= 1
+*/
+int Videostream::getWorkers(const Targuments& _args, const Backend& _be)
+{
+	int workers = _args.workers;
+
+	if (workers <= 0)
+		workers = max(1, static_cast<int>(thread::hardware_concurrency()) - 1);
+
+	return min(workers, _be.maxWorkers());
 }
@@ -1,31 +1,86 @@
 #ifndef __VIDEOSTREAM_H__
 #define __VIDEOSTREAM_H__
 
-#include <opencv2/cudawarping.hpp>	// cuda::resize
-#include <opencv2/cudacodec.hpp>
-#include <opencv2/core/opengl.hpp>
+#include <opencv2/videoio.hpp>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <map>
 
 #include "frame.h"
+#include "backend.hpp"
+#include "metric.hpp"
+#include "boundedqueue.hpp"
+#include "csvwriter.hpp"
+#include "colwriter.hpp"
+#include "synthsource.hpp"
+#include "progress.hpp"
+#include "checkpoint.hpp"
+#include "resultcache.hpp"
+#include "sampler.hpp"
+#include "keyframereader.hpp"
 #include "generica.hpp"
 
-#define BATCH_SIZE 10
 #define NEW_H 360
-#define V_CHANNEL 2
+#define QUEUE_PER_WORKER 2	// decoded frames waiting for each analysis worker
+#define KEYFRAMES_OUTPUT "keyframes"	// keyframe sampling: presentation time of each keyframe
+#define ANALYSIS_FILE "analysis.json"	// <name>_meta: analysis size and pyramid level of the outputs
 
 using namespace std;
 
+// a pooled frame travelling through the pipeline, with its decoding order
+typedef struct
+{
+	Frame* frame;
+	long seq;
+}Tinflight;
+
+// frames [begin, end) of a video, processed by one segment worker
+typedef struct
+{
+	int begin;
+	int end;
+}Tsegment;
+
+// output files of one metric (empty path if that format is disabled)
+typedef struct
+{
+	string csv_path;		// <name>_meta/<feature>.csv
+	string cols_path;		// <name>_meta/<feature>.cols
+	Csvwriter csv;
+	Colwriter cols;
+}Tmetricfiles;
+
+// output files of the metrics (and KEYFRAMES_OUTPUT), by name; only the open ones are present
+typedef map<string, Tmetricfiles> Toutfiles;
+
 class Videostream
 {
 private:
 	Tpath source;
-	vector<Frame> frames_batch;
+	Ringbuffer<Frame> frames_batch;		// history, as deep as the enabled metrics need
 	double width, height, area;
 	double fps;
+	double media_fps;		// fps as stored in the video (fps is rounded up)
 	double tot_fps;
 	double duration;
 	
-	cv::Rect blur_roi;		// x, y, w, h
+	cv::Size analysis_size;	// frames are scaled to this size before the metrics
+	double scale;			// analysis height / video height
+	map<string, int> levels;	// pyramid level of each metric, by name
+	vector<cv::Ptr<Metric>> metrics;	// enabled metrics, in registry order (see createMetrics)
+	vector<int> products;		// products built on each frame, by pyramid level (Framecontext::makePlan)
+	vector<int> seed_products;	// the same for seed frames: temporal metrics only
+	cv::Rect blur_roi;		// x, y, w, h, in pixels of the blur level
 	int patch_info[4];		// nx, ny, w, h
+	atomic<bool> stop;		// set by the writer (ESC) to stop decoding
+	int start_frame;		// first frame to decode
+	int resume_frame;		// first frame to write (> start_frame when resuming: motion seed)
+	Checkpoint checkpoint;
+	Sampler sampler;		// frames to analyze
+	Perf perf;				// per-stage timing, see savePerf
+	Progress progress;		// progress line and status.json, see startProgress
+	bool timestamps;		// write the keyframes output (keyframe sampling)
 
 public:
 	// Constructors
@@ -34,7 +89,63 @@ public:
 	// methods
 	void vec2CVRect(const vector<int>& _roi, const bool& _debug);
 	void vec2Patch(const vector<int>& _grid, const bool& _debug);
+	void setScale(const int& _height, const bool& _debug);
+	void setLevels(const map<string, int>& _levels, const bool& _debug);
+	cv::Size getLevelSize(const int& _level) const;
+	static cv::Rect scaleRect(const cv::Rect& _rect, const double& _sx, const double& _sy, const cv::Size& _bounds);
+	void prepare(Targuments& _args);
+	void createMetrics(Targuments& _args);
+	void planProducts();
+	void saveAnalysis(const Targuments& _args) const;
+	bool isPending() const;
+	bool readsPrevious() const;
+	int getHistoryDepth() const;
 	void processing(Targuments _args);
+	void processPipeline(Backend& _be, const Targuments& _args, Toutfiles& _out);
+	void processSegments(const Targuments& _args, Toutfiles& _out);
+
+	// methods::pipeline stages
+	void decodeLoop(Backend& _be, Boundedqueue<Frame*>& _free_q, Boundedqueue<Tinflight>& _decoded_q);
+	void analyzeLoop(Backend& _be, Boundedqueue<Tinflight>& _decoded_q, Boundedqueue<Tinflight>& _analyzed_q, atomic<int>& _active);
+	void analyzeFrame(Backend& _be, Frame& _frame);
+	void seedFrame(Backend& _be, Frame& _frame);
+	void analyzeHistory(Backend& _be, Ringbuffer<Frame>& _history);
+	static int getWorkers(const Targuments& _args, const Backend& _be);
+
+	// methods::segments
+	long segmentLoop(const Targuments& _args, const Tsegment& _seg, Toutfiles& _out);
+	vector<Tsegment> getSegments(const int& _n) const;
+	int getFrameCount() const;
+	static void stitch(Toutfiles& _out, vector<Toutfiles>& _parts);
+	static vector<Tsegment> findSegments(const string& _filename, const int& _tot_frames, const int& _n);
+	static vector<int> findKeyframes(const string& _filename);
+
+	// methods::output
+	void writeFrame(Frame& _frame, Toutfiles& _out);
+	static void writeRow(Tmetricfiles& _files, const int& _count, const float _values[], const int& _n);
+	void openOutput(Targuments& _args, Toutfiles& _out);
+	static void openMetric(Targuments& _args, const string& _feature_name, Tmetricfiles& _files, const vector<string>& _columns, const int _patch_info[], const double& _scale, const int& _level);
+	static void openParts(const Toutfiles& _out, Toutfiles& _part, const int& _index);
+	static void openPart(const Tmetricfiles& _files, Tmetricfiles& _part, const string& _suffix);
+	static void closeOutput(Toutfiles& _out);
+	static void appendPart(Tmetricfiles& _dst, const Tmetricfiles& _part);
+
+	// methods::checkpoint
+	bool resumeOutput(Targuments& _args, Toutfiles& _out);
+	static bool resumeMetric(Tmetricfiles& _files, const string& _meta_dir, const string& _feature_name, const json& _sizes);
+	static json getOutputSizes(Toutfiles& _out);
+	json getFingerprint(const Targuments& _args) const;
+
+	// methods::performance
+	void savePerf(const Targuments& _args, const string& _backend_name) const;
+	void startProgress(Targuments& _args);
+	void stopProgress();
+	long getPendingFrames() const;
+
+	// methods::result cache
+	map<string, string> lookupCache(const Resultcache& _cache, Targuments& _args, const string& _backend_name);
+	static void storeCache(const Resultcache& _cache, Targuments& _args, const map<string, string>& _keys);
+	json getMetricParams(const string& _feature_name, const string& _backend_name) const;
 };
 
 #endif
\ No newline at end of file